@@ -0,0 +1,99 @@
+/****************************************************************************
+* Host micro-benchmarks of the MiROS kernel paths run from the SysTick.
+*
+* Links the kernel with the simulation port (no context switches), so the
+* numbers are the cost of the kernel code alone.
+*
+* SPDX-License-Identifier: GPL-3.0-or-later
+****************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+#include "miros.h"
+#include "miros_port.h"
+
+extern OSThread * volatile OS_curr;
+extern OSThread * volatile OS_next;
+extern OSThread idleThread;
+extern OSThread *OS_thread[32 + 1];
+
+#define BENCH_TICKS 1000000U
+
+static uint32_t stack_idleThread[40];
+static uint32_t stacks[32][40];
+static OSThread threads[32];
+
+static void threadMain(void) {
+}
+
+void OS_onStartup(void) {
+}
+
+static double nsecSince(struct timespec const *t0) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (double)(t1.tv_sec - t0->tv_sec) * 1e9
+           + (double)(t1.tv_nsec - t0->tv_nsec);
+}
+
+/* OS_tick() + OS_sched(), as done by the SysTick, for 32 periodic threads
+ * whose one-tick jobs run as soon as they are picked: the releases, the
+ * ready queue and the job completions are all exercised
+ */
+static void benchSched(void) {
+    double best = 0.0;
+    for (uint32_t round = 0U; round < 5U; round++) { /* best of 5 */
+        struct timespec t0;
+        double ns;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (uint32_t i = 0U; i < BENCH_TICKS; i++) {
+            OS_tick();
+            if (OS_schedEvents != 0U) {
+                OS_sched();
+            }
+            OS_curr = OS_next;
+            if (OS_curr != &idleThread) {
+                OS_jobComplete(OS_curr);
+            }
+        }
+        ns = nsecSince(&t0) / BENCH_TICKS;
+        if ((round == 0U) || (ns < best)) {
+            best = ns;
+        }
+    }
+    printf("OS_tick() + OS_sched() with 32 periodic threads: %.2f ns/tick\n\n",
+           best);
+}
+
+/* OS_tick() cost as more and more threads sleep in OS_delay() */
+static void benchTick(void) {
+    printf("OS_tick() cost vs. number of delayed threads\n");
+    printf("delayed  ns/tick\n");
+    for (uint32_t n = 0U; n <= 32U; n++) {
+        struct timespec t0;
+        if (n > 0U) {
+            /* long enough that nothing expires during the measurement */
+            OS_curr = OS_thread[n];
+            OS_delay(0x40000000U - n);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (uint32_t i = 0U; i < BENCH_TICKS; i++) {
+            OS_tick();
+        }
+        printf("%7u %8.2f\n", (unsigned)n, nsecSince(&t0) / BENCH_TICKS);
+    }
+}
+
+int main(void) {
+    OS_init(stack_idleThread, sizeof(stack_idleThread));
+    for (uint32_t i = 0U; i < 32U; i++) {
+        OSThread_start(&threads[i], (uint8_t)(i + 1U), &threadMain,
+                       stacks[i], sizeof(stacks[i]),
+                       1U, 10U * (i + 1U));
+    }
+
+    benchSched();
+    benchTick();
+    return 0;
+}
@@ -0,0 +1,171 @@
+/****************************************************************************
+* Board support for the POSIX (Linux host) port of MiROS.
+*
+* Provides the callbacks the STM32 build implements in stm32f1xx_it.c:
+* the SysTick, OS_onStartup(), OS_onIdle() and Q_onAssert().
+*
+* Environment:
+*   MIROS_TICKS=<n>  exit at the first idle time after n ticks and print
+*                    the per-tick kernel cost and the response times from
+*                    the kernel's job logs
+*
+* With OS_TICKLESS=1 the idle thread stretches the interval timer up to the
+* next scheduler event instead of taking every tick.
+*
+* SPDX-License-Identifier: GPL-3.0-or-later
+****************************************************************************/
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "miros.h"
+#include "miros_port.h"
+#include "qassert.h"
+
+extern uint32_t volatile OSTotalTicks;
+extern OSThread *OS_thread[32 + 1];
+
+static uint32_t l_tickLimit; /* 0 means run forever */
+static uint64_t l_tickNsec;  /* accumulated time spent in the SysTick */
+static uint64_t l_tickMaxNsec;
+static uint32_t l_interrupts; /* SIGALRMs actually taken */
+static uint32_t l_schedTicks; /* SysTicks that had to call OS_sched() */
+static volatile sig_atomic_t l_done; /* the tick limit was reached */
+
+#if OS_TICKLESS
+static uint32_t volatile l_sleepTicks; /* ticks covered by the armed timer */
+#endif
+
+static uint64_t nsecNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+static void SysTick_Handler(int sig) {
+    uint64_t start = nsecNow();
+    uint64_t elapsed;
+    (void)sig;
+
+    OS_portIsrEnter();
+    ++l_interrupts;
+#if OS_TICKLESS
+    if (l_sleepTicks > 1U) { /* woke up from a tickless idle stretch */
+        OS_tickAnnounce(l_sleepTicks - 1U);
+    }
+    l_sleepTicks = 0U;
+#endif
+    OS_tick();
+    if (OS_schedEvents != 0U) { /* else the scheduling decision still holds */
+        ++l_schedTicks;
+        OS_INT_DISABLE();
+        OS_sched();
+        OS_INT_ENABLE();
+    }
+
+    elapsed = nsecNow() - start;
+    l_tickNsec += elapsed;
+    if (elapsed > l_tickMaxNsec) {
+        l_tickMaxNsec = elapsed;
+    }
+
+    if ((l_tickLimit != 0U) && (OSTotalTicks >= l_tickLimit)) {
+        l_done = 1; /* reported by the idle thread, outside the handler */
+    }
+    OS_portIsrExit();
+}
+
+/* printf() and exit() are not async-signal-safe, so the SysTick only flags
+* the end of the run and the idle thread prints the report
+*/
+static void report(void) {
+    OS_INT_DISABLE(); /* freeze the statistics */
+    printf("ticks: %u  interrupts: %u  OS_sched: %u  SysTick avg: %llu ns  max: %llu ns\n",
+           (unsigned)OSTotalTicks, (unsigned)l_interrupts, (unsigned)l_schedTicks,
+           (unsigned long long)(l_tickNsec / l_interrupts),
+           (unsigned long long)l_tickMaxNsec);
+    printf("prio    jobs  misses overruns  R_min  R_max  R_avg [ticks]\n");
+    for (uint32_t i = 1U; i < Q_DIM(OS_thread); i++) {
+        OSThread const *th = OS_thread[i];
+        if (th) {
+            printf("%4u %7u %7u %8u %6u %6u %6u\n", (unsigned)i,
+                   (unsigned)th->jobLog.count, (unsigned)th->deadlineMisses,
+                   (unsigned)th->overruns,
+                   (unsigned)th->jobLog.minResponse,
+                   (unsigned)th->jobLog.maxResponse,
+                   (unsigned)((th->jobLog.count != 0U)
+                       ? th->jobLog.sumResponse / th->jobLog.count : 0U));
+        }
+    }
+    exit(0);
+}
+
+void OS_onStartup(void) {
+    struct sigaction sa;
+    struct itimerval tv;
+    char const *ticks = getenv("MIROS_TICKS");
+
+    OS_clockInit();
+    if (ticks != (char const *)0) {
+        l_tickLimit = (uint32_t)strtoul(ticks, (char **)0, 10);
+    }
+
+    sa.sa_handler = &SysTick_Handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGALRM, &sa, (struct sigaction *)0);
+
+    /* the SysTick rate */
+    tv.it_interval.tv_sec = 0;
+    tv.it_interval.tv_usec = 1000000 / TICKS_PER_SEC;
+    tv.it_value = tv.it_interval;
+    setitimer(ITIMER_REAL, &tv, (struct itimerval *)0);
+}
+
+void OS_onIdle(void) {
+    if (l_done != 0) {
+        report();
+    }
+#if OS_TICKLESS
+    sigset_t pending;
+    uint32_t ticks;
+
+    OS_INT_DISABLE();
+    sigpending(&pending);
+    ticks = OS_nextEventTicks();
+    if ((ticks > 1U) && !sigismember(&pending, SIGALRM)) {
+        struct itimerval tv;
+        sigset_t waitSet;
+        uint64_t usec;
+
+        /* the next tick is still due on time, the following ones are
+        * skipped up to the event; afterwards the timer resumes its period
+        */
+        getitimer(ITIMER_REAL, &tv);
+        usec = (uint64_t)tv.it_value.tv_sec * 1000000U
+               + (uint64_t)tv.it_value.tv_usec
+               + (uint64_t)(ticks - 1U) * (1000000U / TICKS_PER_SEC);
+        tv.it_value.tv_sec = (time_t)(usec / 1000000U);
+        tv.it_value.tv_usec = (suseconds_t)(usec % 1000000U);
+        l_sleepTicks = ticks;
+        setitimer(ITIMER_REAL, &tv, (struct itimerval *)0);
+
+        sigprocmask(SIG_BLOCK, (sigset_t *)0, &waitSet);
+        sigdelset(&waitSet, SIGALRM);
+        sigsuspend(&waitSet);
+    }
+    OS_INT_ENABLE();
+#else
+    pause(); /* stop the process and wait for the next "interrupt" */
+#endif
+}
+
+void Q_onAssert(char const *module, int loc) {
+    fprintf(stderr, "Assertion failed in %s:%d\n", module, loc);
+    abort();
+}
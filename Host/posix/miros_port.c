@@ -0,0 +1,139 @@
+/****************************************************************************
+* MInimal Real-time Operating System (MiROS), POSIX (Linux host) port.
+*
+* SPDX-License-Identifier: GPL-3.0-or-later
+****************************************************************************/
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <time.h>
+#include "miros.h"
+#include "miros_port.h"
+#include "qassert.h"
+
+Q_DEFINE_THIS_FILE
+
+extern OSThread * volatile OS_curr;
+extern OSThread * volatile OS_next;
+
+static sigset_t l_tickSet; /* the "interrupts" masked by OS_INT_DISABLE() */
+static volatile sig_atomic_t l_inIsr;  /* inside the simulated SysTick */
+static volatile sig_atomic_t l_pendSV; /* context switch requested */
+static uint64_t l_clockStart; /* CLOCK_MONOTONIC at OS_clockInit() [us] */
+
+void OS_portInit(void) {
+    sigemptyset(&l_tickSet);
+    sigaddset(&l_tickSet, SIGALRM);
+}
+
+void OS_portThreadInit(OSThread *me, OSThreadHandler threadHandler,
+                       void *stkSto, uint32_t stkSize)
+{
+    ucontext_t *ctx = malloc(sizeof(ucontext_t));
+    void *stk = malloc(OS_PORT_STACK_SIZE);
+
+    /* the target stacks are far too small for host code and signal frames */
+    (void)stkSto;
+    (void)stkSize;
+    Q_ASSERT((ctx != (ucontext_t *)0) && (stk != (void *)0));
+
+    getcontext(ctx);
+    ctx->uc_stack.ss_sp = stk;
+    ctx->uc_stack.ss_size = OS_PORT_STACK_SIZE;
+    ctx->uc_link = (ucontext_t *)0;
+    sigemptyset(&ctx->uc_sigmask); /* threads start with interrupts enabled */
+    makecontext(ctx, (void (*)(void))threadHandler, 0);
+
+    me->sp = ctx;
+}
+
+/* must be called with SIGALRM masked, like the real PendSV runs with
+* interrupts disabled; the mask is saved and restored with each context
+*/
+static void PendSV_Handler(void) {
+    OSThread *prev = OS_curr;
+
+    l_pendSV = 0;
+    OS_curr = OS_next;
+    if (prev == (OSThread *)0) {
+        setcontext((ucontext_t *)OS_next->sp);
+    }
+    else if (prev != OS_next) {
+        swapcontext((ucontext_t *)prev->sp, (ucontext_t *)OS_next->sp);
+    }
+}
+
+void OS_portIntDisable(void) {
+    if (l_inIsr == 0) {
+        sigprocmask(SIG_BLOCK, &l_tickSet, (sigset_t *)0);
+    }
+}
+
+void OS_portIntEnable(void) {
+    if (l_inIsr == 0) {
+        sigprocmask(SIG_BLOCK, &l_tickSet, (sigset_t *)0);
+        if (l_pendSV != 0) {
+            PendSV_Handler();
+        }
+        sigprocmask(SIG_UNBLOCK, &l_tickSet, (sigset_t *)0);
+    }
+}
+
+/* mask SIGALRM, returning whether it was masked (or a handler runs) */
+uint32_t OS_portIntSave(void) {
+    sigset_t prev;
+    if (l_inIsr != 0) {
+        return 1U;
+    }
+    sigprocmask(SIG_BLOCK, &l_tickSet, &prev);
+    return sigismember(&prev, SIGALRM) ? 1U : 0U;
+}
+
+void OS_portIntRestore(uint32_t state) {
+    if (state == 0U) {
+        OS_portIntEnable();
+    }
+}
+
+void OS_portPendSV(void) {
+    l_pendSV = 1;
+
+    /* like the hardware, take the PendSV right away unless interrupts
+    * are disabled or an interrupt is in progress
+    */
+    if (l_inIsr == 0) {
+        sigset_t curr;
+        sigprocmask(SIG_BLOCK, (sigset_t *)0, &curr);
+        if (!sigismember(&curr, SIGALRM)) {
+            OS_portIntEnable();
+        }
+    }
+}
+
+void OS_portIsrEnter(void) {
+    l_inIsr = 1;
+}
+
+void OS_portIsrExit(void) {
+    l_inIsr = 0;
+    if (l_pendSV != 0) { /* tail-chain into the PendSV */
+        PendSV_Handler();
+    }
+}
+
+static uint64_t clockMonotonicUs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000U + (uint64_t)ts.tv_nsec / 1000U;
+}
+
+void OS_clockInit(void) {
+    l_clockStart = clockMonotonicUs();
+}
+
+uint64_t OS_clockUs(void) {
+    return clockMonotonicUs() - l_clockStart;
+}
@@ -0,0 +1,40 @@
+/****************************************************************************
+* MInimal Real-time Operating System (MiROS), POSIX (Linux host) port.
+*
+* The port runs the unmodified kernel and application as a single native
+* process:
+* - every thread gets its own ucontext_t and host stack (the tiny target
+*   stacks passed to OSThread_start() are not used),
+* - SIGALRM from an interval timer stands in for the SysTick interrupt,
+* - masking SIGALRM stands in for disabling interrupts,
+* - a deferred swapcontext() stands in for the PendSV exception.
+*
+* SPDX-License-Identifier: GPL-3.0-or-later
+****************************************************************************/
+#ifndef MIROS_PORT_H
+#define MIROS_PORT_H
+
+#define OS_INT_DISABLE()    OS_portIntDisable()
+#define OS_INT_ENABLE()     OS_portIntEnable()
+#define OS_INT_SAVE(st_)    ((st_) = OS_portIntSave())
+#define OS_INT_RESTORE(st_) OS_portIntRestore(st_)
+#define OS_TRIGGER_PENDSV() OS_portPendSV()
+
+/* size of the host stack allocated for every thread */
+#define OS_PORT_STACK_SIZE  (64U * 1024U)
+
+void OS_portInit(void);
+void OS_portThreadInit(OSThread *me, OSThreadHandler threadHandler,
+                       void *stkSto, uint32_t stkSize);
+
+void OS_portIntDisable(void);
+void OS_portIntEnable(void);
+uint32_t OS_portIntSave(void);
+void OS_portIntRestore(uint32_t state);
+void OS_portPendSV(void);
+
+/* bracket the body of the simulated interrupt handlers */
+void OS_portIsrEnter(void);
+void OS_portIsrExit(void);
+
+#endif /* MIROS_PORT_H */
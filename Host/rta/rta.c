@@ -0,0 +1,250 @@
+/****************************************************************************
+* Offline response-time analysis (RTA) of a MiROS task set.
+*
+* Reads a task table and computes the exact worst-case response time of
+* every periodic task under the kernel's fixed-priority policy (Deadline
+* Monotonic, i.e. Rate Monotonic for implicit deadlines) with the blocking
+* introduced by the Non-Preemptive Protocol used by sem_wait()/sem_post():
+*
+*   R_i = C_i + B_i + sum_{j in hp(i)} ceil(R_i / T_j) * C_j
+*
+* Under the NPP a critical section runs with preemption disabled, so a task
+* can be blocked once, by the longest critical section of ANY lower
+* priority task, whatever semaphore it uses:
+*
+*   B_i = max_{k in lp(i)} cs_k
+*
+* Tasks with equal Di and Ti share a priority level in the kernel and are
+* time-sliced round-robin, so each one counts in hp() of the others.
+*
+* A Deferrable Server (keyword "deferrable") keeps its capacity Cs through
+* its period Ts, so it can run at the end of one period and again right at
+* the start of the next. It interferes like a task with release jitter
+* Ts - Cs, the term of OS_interference() in the kernel:
+*
+*   ceil((R_i + T_j - C_j) / T_j) * C_j
+*
+* Input (file argument or stdin), one task per line, times in ticks:
+*
+*   # name  Ci   Ti   [Di]  [semaphore:length ...]  [deferrable]
+*   task1   300  500        mutex:1
+*
+* Di defaults to Ti and must not exceed it. Liu & Layland and the
+* hyperbolic bound are printed alongside for comparison (they do not hold
+* with a Deferrable Server). The exit status is 0 when every task meets its
+* deadline, 1 otherwise.
+*
+* SPDX-License-Identifier: GPL-3.0-or-later
+****************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define MAX_TASKS 32
+#define MAX_LINE  256
+
+typedef struct {
+    char name[32];
+    uint32_t Ci;
+    uint32_t Ti;
+    uint32_t Di;
+    uint32_t cs;     /* longest critical section, any semaphore [ticks] */
+    uint32_t Bi;     /* NPP blocking term */
+    uint32_t order;  /* position in the input, last tie-breaker */
+    bool deferrable; /* a Deferrable Server, with jitter Ti - Ci */
+    uint64_t Ri;     /* worst-case response time */
+    bool ok;
+} RtaTask;
+
+static RtaTask l_task[MAX_TASKS];
+static uint32_t l_nTasks;
+
+static void fail(char const *file, unsigned line, char const *msg) {
+    fprintf(stderr, "%s:%u: %s\n", file, line, msg);
+    exit(2);
+}
+
+static void parse(FILE *in, char const *file) {
+    char buf[MAX_LINE];
+    unsigned line = 0U;
+
+    while (fgets(buf, sizeof(buf), in) != (char *)0) {
+        char *tok;
+        char *save;
+        RtaTask *t;
+        unsigned long v[3];
+        uint32_t n = 0U;
+
+        ++line;
+        if (strchr(buf, '#') != (char *)0) {
+            *strchr(buf, '#') = '\0';
+        }
+        tok = strtok_r(buf, " \t\r\n", &save);
+        if (tok == (char *)0) {
+            continue; /* blank or comment line */
+        }
+        if (l_nTasks == MAX_TASKS) {
+            fail(file, line, "too many tasks");
+        }
+        t = &l_task[l_nTasks];
+        snprintf(t->name, sizeof(t->name), "%s", tok);
+        t->order = l_nTasks;
+
+        while ((tok = strtok_r((char *)0, " \t\r\n", &save)) != (char *)0) {
+            char *colon = strchr(tok, ':');
+            char *end;
+            if (strcmp(tok, "deferrable") == 0) {
+                t->deferrable = true;
+            }
+            else if (colon != (char *)0) { /* semaphore:length */
+                unsigned long len = strtoul(colon + 1, &end, 10);
+                if ((end == colon + 1) || (*end != '\0')) {
+                    fail(file, line, "bad critical section length");
+                }
+                if (len > t->cs) {
+                    t->cs = (uint32_t)len;
+                }
+            }
+            else if (n < 3U) {
+                v[n] = strtoul(tok, &end, 10);
+                if ((end == tok) || (*end != '\0')) {
+                    fail(file, line, "bad number");
+                }
+                ++n;
+            }
+            else {
+                fail(file, line, "unexpected field");
+            }
+        }
+        if (n < 2U) {
+            fail(file, line, "expected: name Ci Ti [Di] [semaphore:length ...] [deferrable]");
+        }
+        t->Ci = (uint32_t)v[0];
+        t->Ti = (uint32_t)v[1];
+        t->Di = (n == 3U) ? (uint32_t)v[2] : t->Ti;
+        if ((t->Ci == 0U) || (t->Ti == 0U) || (t->Di == 0U) || (t->Di > t->Ti)) {
+            fail(file, line, "need 0 < Ci, 0 < Di <= Ti");
+        }
+        if (t->cs > t->Ci) {
+            fail(file, line, "critical section longer than Ci");
+        }
+        ++l_nTasks;
+    }
+}
+
+/* the kernel's rank order (OS_rankedBefore): Di, then Ti; equal tasks share
+ * a level and are listed in input order */
+static int byPriority(void const *pa, void const *pb) {
+    RtaTask const *a = pa;
+    RtaTask const *b = pb;
+    if (a->Di != b->Di) {
+        return (a->Di < b->Di) ? -1 : 1;
+    }
+    if (a->Ti != b->Ti) {
+        return (a->Ti < b->Ti) ? -1 : 1;
+    }
+    return (a->order < b->order) ? -1 : 1;
+}
+
+static bool sameLevel(RtaTask const *a, RtaTask const *b) {
+    return (a->Di == b->Di) && (a->Ti == b->Ti);
+}
+
+static void analyse(void) {
+    for (uint32_t i = 0U; i < l_nTasks; i++) {
+        RtaTask *t = &l_task[i];
+        uint64_t r;
+        uint64_t prev;
+
+        t->Bi = 0U;
+        for (uint32_t k = i + 1U; k < l_nTasks; k++) {
+            if (!sameLevel(&l_task[k], t) && (l_task[k].cs > t->Bi)) {
+                t->Bi = l_task[k].cs;
+            }
+        }
+
+        /* fixed-point iteration, stopped as soon as the deadline is passed */
+        r = (uint64_t)t->Ci + t->Bi;
+        do {
+            prev = r;
+            r = (uint64_t)t->Ci + t->Bi;
+            for (uint32_t j = 0U; j < l_nTasks; j++) {
+                if ((j < i) || ((j != i) && sameLevel(&l_task[j], t))) {
+                    RtaTask const *h = &l_task[j];
+                    uint64_t jitter = h->deferrable ? (h->Ti - h->Ci) : 0U;
+                    r += ((prev + jitter + h->Ti - 1U) / h->Ti) * h->Ci;
+                }
+            }
+        } while ((r != prev) && (r <= t->Di));
+
+        t->Ri = r;
+        t->ok = (r <= t->Di);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    FILE *in = stdin;
+    char const *file = "<stdin>";
+    double u = 0.0;
+    double hyp = 1.0;
+    double ll;
+    bool ok = true;
+    bool bounds = true; /* the utilization bounds apply */
+
+    if (argc > 2) {
+        fprintf(stderr, "usage: %s [task-table]\n", argv[0]);
+        return 2;
+    }
+    if (argc == 2) {
+        file = argv[1];
+        in = fopen(file, "r");
+        if (in == (FILE *)0) {
+            perror(file);
+            return 2;
+        }
+    }
+    parse(in, file);
+    if (in != stdin) {
+        fclose(in);
+    }
+    if (l_nTasks == 0U) {
+        fprintf(stderr, "%s: no tasks\n", file);
+        return 2;
+    }
+
+    qsort(l_task, l_nTasks, sizeof(l_task[0]), &byPriority);
+    analyse();
+
+    printf("   # name                   Ci      Ti      Di      Bi      Ri\n");
+    for (uint32_t i = 0U; i < l_nTasks; i++) {
+        RtaTask const *t = &l_task[i];
+        u   += (double)t->Ci / t->Ti;
+        hyp *= (double)t->Ci / t->Ti + 1.0;
+        if (t->deferrable) {
+            bounds = false;
+        }
+        if (t->ok) {
+            printf("%4u %-16s %7u %7u %7u %7u %7u\n",
+                   (unsigned)(i + 1U), t->name, (unsigned)t->Ci,
+                   (unsigned)t->Ti, (unsigned)t->Di, (unsigned)t->Bi,
+                   (unsigned)t->Ri);
+        }
+        else {
+            printf("%4u %-16s %7u %7u %7u %7u  >%6u  DEADLINE MISS\n",
+                   (unsigned)(i + 1U), t->name, (unsigned)t->Ci,
+                   (unsigned)t->Ti, (unsigned)t->Di, (unsigned)t->Bi,
+                   (unsigned)t->Di);
+            ok = false;
+        }
+    }
+    ll = l_nTasks * (pow(2.0, 1.0 / l_nTasks) - 1.0);
+    printf("U = %.3f, Liu & Layland bound %.3f (%s), hyperbolic product %.3f (%s)\n",
+           u, ll, !bounds ? "n/a" : (u <= ll) ? "pass" : "inconclusive",
+           hyp, !bounds ? "n/a" : (hyp <= 2.0) ? "pass" : "inconclusive");
+    printf("response-time analysis with NPP blocking: %s\n",
+           ok ? "schedulable" : "NOT schedulable");
+    return ok ? 0 : 1;
+}
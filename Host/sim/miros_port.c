@@ -0,0 +1,43 @@
+/****************************************************************************
+* MInimal Real-time Operating System (MiROS), discrete-event simulation port.
+*
+* SPDX-License-Identifier: GPL-3.0-or-later
+****************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "miros.h"
+#include "miros_port.h"
+#include "qassert.h"
+
+bool OS_simPendSV;
+uint64_t OS_simClockUs;
+
+void OS_portInit(void) {
+}
+
+void OS_portThreadInit(OSThread *me, OSThreadHandler threadHandler,
+                       void *stkSto, uint32_t stkSize)
+{
+    (void)threadHandler;
+    (void)stkSto;
+    (void)stkSize;
+    me->sp = (void *)0;
+}
+
+void OS_clockInit(void) {
+}
+
+/* virtual time has no resolution below one tick */
+uint64_t OS_clockUs(void) {
+    return OS_simClockUs;
+}
+
+void OS_onIdle(void) {
+}
+
+void Q_onAssert(char const *module, int loc) {
+    fprintf(stderr, "Assertion failed in %s:%d\n", module, loc);
+    abort();
+}
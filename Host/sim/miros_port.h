@@ -0,0 +1,32 @@
+/****************************************************************************
+* MInimal Real-time Operating System (MiROS), discrete-event simulation port.
+*
+* The threads are never executed: the simulator in sim.c plays the part of
+* the SysTick and of TaskAction() against a virtual clock, so there are no
+* interrupts to mask and a context switch is just a change of OS_curr.
+*
+* SPDX-License-Identifier: GPL-3.0-or-later
+****************************************************************************/
+#ifndef MIROS_PORT_H
+#define MIROS_PORT_H
+
+#define OS_INT_DISABLE()    ((void)0)
+#define OS_INT_ENABLE()     ((void)0)
+#define OS_INT_SAVE(st_)    ((st_) = 0U)
+#define OS_INT_RESTORE(st_) ((void)(st_))
+#define OS_TRIGGER_PENDSV() (OS_simPendSV = true)
+
+/* context switch requested by OS_sched(), taken by the simulator */
+extern bool OS_simPendSV;
+
+/* virtual time read by OS_clockUs(), set by the simulator at each tick */
+extern uint64_t OS_simClockUs;
+
+/* end of the simulation: the exit status, 0 unless a test overrides it */
+int OS_simCheck(void);
+
+void OS_portInit(void);
+void OS_portThreadInit(OSThread *me, OSThreadHandler threadHandler,
+                       void *stkSto, uint32_t stkSize);
+
+#endif /* MIROS_PORT_H */
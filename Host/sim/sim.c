@@ -0,0 +1,353 @@
+/****************************************************************************
+* Discrete-event simulator for MiROS task sets.
+*
+* Links the unmodified kernel (Src/miros.c) and application (Src/main.c).
+* When the application calls OS_run(), OS_onStartup() takes over and drives
+* OS_tick()/OS_sched() against a virtual clock instead of arming a timer:
+* - the running periodic thread is charged one unit of its remainingTime
+*   per tick, exactly like TaskAction() does on the target,
+* - between two events (a release, the completion of the running job, the
+*   arrival of an aperiodic job) the scheduling decision cannot change, so
+*   the clock jumps straight to the next event,
+* - ticks in which the Background Server executes an aperiodic job are
+*   stepped one by one, because the kernel serves them one unit per tick,
+*   and so are the ticks of the aperiodic server, the ticks in which an
+*   aperiodic job waits for slack to steal and the ticks in which threads
+*   of equal rank share the CPU round-robin.
+*
+* Environment:
+*   MIROS_TICKS=<n>  simulated horizon in ticks (default: one hyperperiod)
+*   MIROS_TABLE=<f>  simulate one hyperperiod and write its schedule to the
+*                    C file f, as the dispatch table of the OS_SCHED_TABLE
+*                    mode (refused if a deadline is missed)
+*
+* SPDX-License-Identifier: GPL-3.0-or-later
+****************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "miros.h"
+#include "miros_port.h"
+#include "qassert.h"
+
+Q_DEFINE_THIS_FILE
+
+extern OSThread * volatile OS_curr;
+extern OSThread * volatile OS_next;
+extern OSThread *OS_thread[32 + 1];
+extern uint32_t volatile OSTotalTicks;
+extern OSThread idleThread;
+extern AperiodicTask aperiodicTaskQueue[MAX_APERIODIC_TASKS];
+extern uint32_t aperiodicTaskCount;
+extern uint32_t aperiodicTaskNextId;
+extern OSHeapEntry OS_releaseHeap[32];
+extern uint32_t OS_releaseCount;
+extern OSThread *OS_server;
+#if OS_SCHED_POLICY == OS_SCHED_TABLE
+extern uint32_t OS_dispatchNext;
+#endif
+
+typedef struct {
+    uint32_t arrival;
+    uint32_t finish;      /* 0 while not finished */
+} SimAperiodicStats;
+
+static SimAperiodicStats l_aper[MAX_APERIODIC_TASKS]; /* by id, the jobs added before OS_run() */
+static uint32_t l_aperCount;
+static uint32_t l_events;
+
+static char const *l_tableFile; /* MIROS_TABLE, 0 if not generating */
+static OSDispatchEntry *l_table; /* the schedule, one entry per dispatch */
+static uint32_t l_tableCount;
+static uint32_t l_tableSize;
+
+static uint32_t gcd(uint32_t a, uint32_t b) {
+    while (b != 0U) {
+        uint32_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+static uint32_t hyperperiod(void) {
+    uint32_t h = 1U;
+    for (uint32_t i = 1U; i < Q_DIM(OS_thread); i++) {
+        if (OS_thread[i]) {
+            h = (h / gcd(h, OS_thread[i]->Ti)) * OS_thread[i]->Ti;
+        }
+    }
+    return h;
+}
+
+/* the next release, straight from the root of the kernel's release heap */
+static uint32_t nextRelease(void) {
+    return (OS_releaseCount != 0U) ? OS_releaseHeap[0].key : UINT32_MAX;
+}
+
+/* first tick after t at which the Background Server has work to do: the
+* root of the kernel's aperiodic heap is the earliest job
+*/
+static uint32_t nextAperiodic(uint32_t t) {
+    if (aperiodicTaskCount == 0U) {
+        return UINT32_MAX;
+    }
+    return (aperiodicTaskQueue[0].arrivalTime > t)
+           ? aperiodicTaskQueue[0].arrivalTime : (t + 1U);
+}
+
+/* the thread OS_curr runs from tick t on */
+static void dispatched(uint32_t t) {
+    if ((l_tableFile == (char const *)0)
+        || ((l_tableCount != 0U) && (l_table[l_tableCount - 1U].prio == OS_curr->prio))) {
+        return;
+    }
+    if (l_tableCount == l_tableSize) {
+        l_tableSize = (l_tableSize != 0U) ? (2U * l_tableSize) : 64U;
+        l_table = realloc(l_table, l_tableSize * sizeof(l_table[0]));
+        Q_ASSERT(l_table != (OSDispatchEntry *)0);
+    }
+    l_table[l_tableCount].time = t;
+    l_table[l_tableCount].prio = OS_curr->prio;
+    ++l_tableCount;
+}
+
+/* the running thread executes n ticks of its job */
+static void charge(OSThread *th, uint32_t n) {
+    if ((th == &idleThread) || (th == OS_server) || !th->isActive) {
+        return; /* the kernel itself charges the server, in OS_tick() */
+    }
+    Q_ASSERT(n <= th->remainingTime);
+    th->remainingTime -= n;
+}
+
+/* a periodic job whose work is done, but which has not run since the tick
+* that ended its last unit: like TaskAction() on the target, it calls
+* OS_waitNextPeriod() as soon as it runs again
+*/
+static bool finishing(OSThread const *th) {
+    return (th != &idleThread) && (th != OS_server) && th->isActive
+           && (th->remainingTime == 0U);
+}
+
+static void takePendSV(void) {
+    if (OS_simPendSV) {
+        OS_simPendSV = false;
+        OS_curr = OS_next;
+    }
+}
+
+/* note the aperiodic jobs that have just been finished at tick finish: the
+* kernel removes them from its queue
+*/
+static void aperiodicFinished(uint32_t finish) {
+    static bool queued[MAX_APERIODIC_TASKS];
+    for (uint32_t id = 0U; id < l_aperCount; id++) {
+        queued[id] = false;
+    }
+    for (uint32_t i = 0U; i < aperiodicTaskCount; i++) {
+        if (aperiodicTaskQueue[i].id < l_aperCount) {
+            queued[aperiodicTaskQueue[i].id] = true;
+        }
+    }
+    for (uint32_t id = 0U; id < l_aperCount; id++) {
+        if (!queued[id] && (l_aper[id].finish == 0U)) {
+            l_aper[id].finish = finish;
+        }
+    }
+}
+
+/* one SysTick at tick t, followed by the execution of the chosen thread */
+static void step(uint32_t t) {
+    OS_simClockUs = (uint64_t)t * OS_TICK_US;
+    OSTotalTicks = t - 1U;
+    OS_tick();
+    aperiodicFinished(t); /* by the server, in the tick that just ended */
+    if (OS_schedEvents != 0U) {
+        OS_sched();
+    }
+    takePendSV();
+    dispatched(t);
+    while (finishing(OS_curr)) { /* done at tick t, the CPU goes on at once */
+        OS_waitNextPeriod();
+        takePendSV();
+        dispatched(t);
+    }
+    aperiodicFinished(t + 1U); /* by the Background Server, in tick t */
+    charge(OS_curr, 1U);
+    ++l_events;
+}
+
+static void simulate(uint32_t horizon) {
+    uint32_t t;
+
+    /* the very first scheduling decision, done by OS_run() on the target */
+    OSTotalTicks = 0U;
+    OS_sched();
+    takePendSV();
+    dispatched(0U);
+    charge(OS_curr, 1U);
+
+    t = 0U;
+    while (t < horizon) {
+        uint32_t next = nextRelease();
+
+        if (OS_curr == &idleThread) {
+            uint32_t a = nextAperiodic(t);
+            if (a < next) {
+                next = a;
+            }
+        }
+        else if (OS_curr->isActive && (t + OS_curr->remainingTime + 1U < next)) {
+            next = t + OS_curr->remainingTime + 1U; /* the tick ending its work */
+        }
+        else if (!OS_curr->isActive) {
+            next = t + 1U;
+        }
+        if ((OS_curr->rrNext != (OSThread *)0) && (OS_curr->rrNext != OS_curr)) {
+            next = t + 1U; /* round-robin: the slices are counted by OS_tick() */
+        }
+        if (OS_schedEvents != 0U) {
+            next = t + 1U; /* raised since the last OS_sched(), due at the next tick */
+        }
+        if ((OS_curr == OS_server) && OS_curr->isActive) {
+            next = t + 1U; /* the server executes aperiodic jobs tick by tick */
+        }
+        if ((OS_server != (OSThread *)0) || OS_SLACK_STEALING) {
+            /* a waiting server may resume, or an aperiodic job steal slack */
+            uint32_t a = nextAperiodic(t);
+            if (a < next) {
+                next = a;
+            }
+        }
+#if OS_SCHED_POLICY == OS_SCHED_TABLE
+        if (OS_dispatchNext < next) {
+            next = OS_dispatchNext;
+        }
+#endif
+
+        if (next > horizon) {
+            next = horizon;
+        }
+        if (next > t + 1U) { /* fast-forward: nothing changes in between */
+            /* the kernel charges the time run so far at the next OS_tick(),
+            * from the virtual clock
+            */
+            charge(OS_curr, next - t - 1U);
+        }
+        t = next;
+        if (t < horizon) {
+            step(t);
+        }
+    }
+}
+
+static void report(uint32_t horizon, double seconds) {
+    printf("simulated %u ticks (%.3f s) in %u events, %.3f ms wall, %.1f Mticks/s\n",
+           (unsigned)horizon, (double)horizon / TICKS_PER_SEC,
+           (unsigned)l_events, seconds * 1e3,
+           (seconds > 0.0) ? (horizon / seconds) / 1e6 : 0.0);
+    printf("prio      Ci      Ti      Di    jobs  misses  R_min  R_max  R_avg\n");
+    for (uint32_t i = 1U; i < Q_DIM(OS_thread); i++) {
+        OSThread const *th = OS_thread[i];
+        if (th) {
+            OSJobLog const *log = &th->jobLog;
+            printf("%4u %7u %7u %7u %7u %7u %6u %6u %6.1f\n",
+                   (unsigned)i, (unsigned)th->Ci, (unsigned)th->startupTi,
+                   (unsigned)th->Di, (unsigned)log->count,
+                   (unsigned)th->deadlineMisses,
+                   (unsigned)log->minResponse, (unsigned)log->maxResponse,
+                   (log->count != 0U) ? (double)log->sumResponse / log->count : 0.0);
+        }
+    }
+    for (uint32_t i = 0U; i < l_aperCount; i++) {
+        if (l_aper[i].finish != 0U) {
+            printf("aperiodic %u: arrival %u, finish %u, response %u\n",
+                   (unsigned)i, (unsigned)l_aper[i].arrival,
+                   (unsigned)l_aper[i].finish,
+                   (unsigned)(l_aper[i].finish - l_aper[i].arrival));
+        }
+        else {
+            printf("aperiodic %u: arrival %u, not finished\n",
+                   (unsigned)i, (unsigned)l_aper[i].arrival);
+        }
+    }
+}
+
+/* called when the simulation is over; a test program linked with the
+* simulator overrides it to check the outcome, its value is the exit status
+*/
+__attribute__((weak)) int OS_simCheck(void) {
+    return 0;
+}
+
+/* write the schedule of one hyperperiod as a dispatch table */
+static void writeTable(uint32_t horizon) {
+    FILE *f;
+    for (uint32_t i = 1U; i < Q_DIM(OS_thread); i++) {
+        if (OS_thread[i] && (OS_thread[i]->deadlineMisses != 0U)) {
+            fprintf(stderr, "prio %u misses deadlines, no table written\n",
+                    (unsigned)i);
+            exit(1);
+        }
+    }
+    f = fopen(l_tableFile, "w");
+    if (f == (FILE *)0) {
+        perror(l_tableFile);
+        exit(1);
+    }
+    fprintf(f, "/* Dispatch table of the OS_SCHED_TABLE (cyclic executive) mode:\n"
+               "* from each time on, in ticks into the hyperperiod, the thread of\n"
+               "* that prio runs (0 is the idle thread).\n"
+               "*\n"
+               "* Generated by the simulator (make -C Host table) from one\n"
+               "* hyperperiod of the application, DO NOT EDIT.\n"
+               "*/\n"
+               "#include <stdint.h>\n"
+               "#include \"miros.h\"\n\n"
+               "#if OS_SCHED_POLICY == OS_SCHED_TABLE\n"
+               "OSDispatchEntry const OS_dispatchTable[] = {\n");
+    for (uint32_t i = 0U; i < l_tableCount; i++) {
+        fprintf(f, "    { %7uU, %2uU },\n",
+                (unsigned)l_table[i].time, (unsigned)l_table[i].prio);
+    }
+    fprintf(f, "};\n"
+               "uint32_t const OS_dispatchCount = %uU;\n"
+               "uint32_t const OS_dispatchHyperperiod = %uU;\n"
+               "uint32_t const OS_dispatchSignature = 0x%08XU;\n"
+               "#endif\n",
+            (unsigned)l_tableCount, (unsigned)horizon,
+            (unsigned)OS_taskSetSignature());
+    fclose(f);
+    printf("dispatch table: %u entries written to %s\n",
+           (unsigned)l_tableCount, l_tableFile);
+}
+
+void OS_onStartup(void) {
+    char const *ticks = getenv("MIROS_TICKS");
+    uint32_t horizon;
+    struct timespec t0, t1;
+
+    l_tableFile = getenv("MIROS_TABLE");
+    horizon = ((ticks != (char const *)0) && (l_tableFile == (char const *)0))
+              ? (uint32_t)strtoul(ticks, (char **)0, 10)
+              : hyperperiod();
+
+    l_aperCount = aperiodicTaskNextId;
+    for (uint32_t i = 0U; i < aperiodicTaskCount; i++) {
+        l_aper[aperiodicTaskQueue[i].id].arrival = aperiodicTaskQueue[i].arrivalTime;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    simulate(horizon);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    report(horizon, (double)(t1.tv_sec - t0.tv_sec)
+                    + (double)(t1.tv_nsec - t0.tv_nsec) * 1e-9);
+    if (l_tableFile != (char const *)0) {
+        writeTable(horizon);
+    }
+    exit(OS_simCheck());
+}
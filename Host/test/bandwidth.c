@@ -0,0 +1,88 @@
+/****************************************************************************
+* Test of the bandwidth servers of EDF (OS_tbsServerStart() and
+* OS_cbsServerStart(), selected by TEST_SERVER).
+*
+* Each trial starts a 4/10 and a C/30 periodic thread, and a server that
+* takes the rest of the processor but one tick in 30 (admission rounds the
+* densities up, so a total of exactly 1 is rejected). Random
+* aperiodic jobs of cost 1, 5 or 20 arrive, alone or in bursts. However
+* they arrive, the periodic threads must miss no deadline and the server
+* must not execute more than its bandwidth, Cs/Ts of the ticks (plus one
+* budget), nor finish a job past the deadline its rule gave; every aperiodic
+* job must be served.
+*
+* SPDX-License-Identifier: GPL-3.0-or-later
+****************************************************************************/
+#include "test.h"
+
+#define HORIZON 3000U
+#define JOBS    100U /* within MAX_APERIODIC_TASKS */
+
+extern OSThread * volatile OS_curr;
+extern uint32_t aperiodicTaskCount;
+
+static OSThread l_periodic[2];
+static OSThread l_server;
+static uint32_t l_serverStack[64];
+static uint32_t l_Cs, l_Ts;
+static uint32_t l_served; /* ticks executed by the server */
+
+/* one unit of an aperiodic job, executed in the current tick */
+static void aperiodic(void) {
+    if (OS_curr == &l_server) {
+        ++l_served;
+    }
+}
+
+int OS_simCheck(void) {
+    TEST_CHECK(aperiodicTaskCount == 0U); /* all served */
+    TEST_CHECK(l_served != 0U);
+    TEST_CHECK(l_served <= (HORIZON * l_Cs) / l_Ts + l_Cs);
+    TEST_CHECK(l_server.deadlineMisses == 0U); /* within the rule's deadlines */
+    for (uint32_t i = 0U; i < 2U; i++) {
+        TEST_CHECK(l_periodic[i].jobLog.count != 0U);
+        TEST_CHECK(l_periodic[i].deadlineMisses == 0U);
+    }
+    return 0;
+}
+
+static void trial(unsigned seed) {
+    static uint32_t const costs[] = { 1U, 5U, 20U };
+    uint32_t C = testRandom(1U, 14U);
+    uint32_t t = 0U;
+    uint32_t work = 0U;
+    (void)seed;
+
+    l_Ts = 30U;
+    l_Cs = 17U - C; /* 4/10 + C/30 + Cs/Ts = 29/30 */
+
+    testInit();
+    TEST_CHECK(testStart(&l_periodic[0], 1U, 4U, 10U, 10U));
+    TEST_CHECK(testStart(&l_periodic[1], 2U, C, 30U, 30U));
+#if TEST_SERVER == OS_SERVER_TBS
+    TEST_CHECK(OS_tbsServerStart(&l_server, 3U, l_serverStack,
+                                 sizeof(l_serverStack), l_Cs, l_Ts));
+#else
+    TEST_CHECK(OS_cbsServerStart(&l_server, 3U, l_serverStack,
+                                 sizeof(l_serverStack), l_Cs, l_Ts));
+#endif
+    /* at most half the server's bandwidth over the horizon, so that all
+    * of it can be served
+    */
+    for (uint32_t i = 0U; i < JOBS; i++) {
+        uint32_t cost = costs[testRandom(0U, 2U)];
+        if ((work + cost) * l_Ts * 2U > HORIZON * l_Cs) {
+            break;
+        }
+        work += cost;
+        t += (testRandom(0U, 3U) == 0U) ? 0U : testRandom(1U, 40U);
+        TEST_CHECK(addAperiodicTask(&aperiodic, t, cost));
+    }
+    testRun(HORIZON);
+}
+
+int main(void) {
+    return testTrials((TEST_SERVER == OS_SERVER_TBS) ? "bandwidth (TBS)"
+                                                     : "bandwidth (CBS)",
+                      200U, &trial);
+}
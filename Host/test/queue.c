@@ -0,0 +1,133 @@
+/****************************************************************************
+* Test of the aperiodic queue (addAperiodicTask()), with a capacity of
+* MAX_APERIODIC_TASKS = 30 jobs.
+*
+* Each trial adds aperiodic jobs in a random order, with many arriving at
+* the same tick, and adds more from the job handler while the simulator
+* runs, some arriving later and some already due, earlier than the job
+* being served. An add must fail exactly when the queue is full. The queue
+* must stay a heap, and every unit must be served for the job due first, in
+* the order of arrival, the jobs arriving together in the order they were
+* added, as kept by the test itself. The jobs are served by the Background
+* Server alone (TEST_SERVER = 0), or with a Polling, a Deferrable or a
+* Sporadic Server, which must then miss no deadline.
+*
+* SPDX-License-Identifier: GPL-3.0-or-later
+****************************************************************************/
+#include "test.h"
+
+#define HORIZON 3000U
+#define JOBS    1000U /* added in a trial, at most */
+
+extern uint32_t volatile OSTotalTicks;
+extern AperiodicTask aperiodicTaskQueue[MAX_APERIODIC_TASKS];
+extern uint32_t aperiodicTaskCount;
+
+static OSThread l_periodic;
+#if TEST_SERVER != 0
+static OSThread l_server;
+static uint32_t l_serverStack[64];
+#endif
+
+/* the jobs added, in the order of the adds (their id) */
+static struct {
+    uint32_t arrival;
+    uint32_t left; /* units not served yet */
+} l_job[JOBS];
+static uint32_t l_jobCount;
+static uint32_t l_jobLeft; /* jobs with units left */
+
+static bool before(AperiodicTask const *a, AperiodicTask const *b) {
+    return (a->arrivalTime < b->arrivalTime)
+           || ((a->arrivalTime == b->arrivalTime) && (a->id < b->id));
+}
+
+static void aperiodic(void);
+
+/* add a job, which must be refused only when the queue is full */
+static void add(uint32_t arrival, uint32_t cost) {
+    bool full = (aperiodicTaskCount == MAX_APERIODIC_TASKS);
+    TEST_CHECK(addAperiodicTask(&aperiodic, arrival, cost) == !full);
+    if (!full) {
+        TEST_CHECK(l_jobCount < JOBS);
+        l_job[l_jobCount].arrival = arrival;
+        l_job[l_jobCount].left = cost;
+        ++l_jobCount;
+        ++l_jobLeft;
+    }
+}
+
+/* one unit of the job due first, executed in this tick */
+static void aperiodic(void) {
+    uint32_t served = JOBS;
+
+    for (uint32_t id = 0U; id < l_jobCount; id++) { /* the earliest, then the first added */
+        if ((l_job[id].left != 0U)
+            && ((served == JOBS) || (l_job[id].arrival < l_job[served].arrival))) {
+            served = id;
+        }
+    }
+    TEST_CHECK(served != JOBS);
+    TEST_CHECK(l_job[served].arrival <= OSTotalTicks);
+    if (--l_job[served].left == 0U) {
+        --l_jobLeft;
+    }
+    /* the kernel has accounted the unit to the same job */
+    TEST_CHECK(aperiodicTaskCount == l_jobLeft);
+    for (uint32_t i = 0U; i < aperiodicTaskCount; i++) {
+        AperiodicTask const *task = &aperiodicTaskQueue[i];
+        TEST_CHECK(task->remainingCost == l_job[task->id].left);
+        TEST_CHECK((i == 0U)
+                   || !before(task, &aperiodicTaskQueue[(i - 1U) / 2U]));
+    }
+
+    if ((OSTotalTicks < HORIZON / 2U) && (testRandom(0U, 7U) == 0U)) {
+        /* more jobs, arriving together, later or already due */
+        uint32_t at = (testRandom(0U, 1U) == 0U)
+                      ? (OSTotalTicks + testRandom(1U, 30U))
+                      : testRandom(0U, OSTotalTicks);
+        for (uint32_t n = testRandom(1U, 4U); n > 0U; n--) {
+            add(at, testRandom(1U, 2U));
+        }
+    }
+}
+
+int OS_simCheck(void) {
+    TEST_CHECK(aperiodicTaskCount == 0U); /* all served */
+    TEST_CHECK(l_jobLeft == 0U);
+    TEST_CHECK(l_periodic.deadlineMisses == 0U);
+#if TEST_SERVER != 0
+    TEST_CHECK(l_server.deadlineMisses == 0U);
+#endif
+    return 0;
+}
+
+static void trial(unsigned seed) {
+    uint32_t n = testRandom(1U, MAX_APERIODIC_TASKS + 5U);
+    (void)seed;
+
+    testInit();
+    TEST_CHECK(testStart(&l_periodic, 1U, 3U, 10U, 10U));
+#if TEST_SERVER == OS_SERVER_POLLING
+    TEST_CHECK(OS_pollingServerStart(&l_server, 2U, l_serverStack,
+                                     sizeof(l_serverStack), 2U, 8U));
+#elif TEST_SERVER == OS_SERVER_DEFERRABLE
+    TEST_CHECK(OS_deferrableServerStart(&l_server, 2U, l_serverStack,
+                                        sizeof(l_serverStack), 2U, 8U));
+#elif TEST_SERVER == OS_SERVER_SPORADIC
+    TEST_CHECK(OS_sporadicServerStart(&l_server, 2U, l_serverStack,
+                                      sizeof(l_serverStack), 2U, 8U));
+#endif
+    for (uint32_t i = 0U; i < n; i++) { /* out of order, many ties */
+        add(testRandom(0U, 20U) * 5U, testRandom(1U, 6U));
+    }
+    testRun(HORIZON);
+}
+
+int main(void) {
+    return testTrials((TEST_SERVER == OS_SERVER_POLLING) ? "queue (PS)"
+                      : (TEST_SERVER == OS_SERVER_DEFERRABLE) ? "queue (DS)"
+                      : (TEST_SERVER == OS_SERVER_SPORADIC) ? "queue (SS)"
+                      : "queue (BS)",
+                      300U, &trial);
+}
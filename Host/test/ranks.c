@@ -0,0 +1,116 @@
+/****************************************************************************
+* Test of the incremental RM/DM ranks (OS_rankInsert/OS_rankRemove).
+*
+* Each trial starts 32 threads in a random prio order, with random Ti and
+* Di drawn so that ties (shared ranks) and admission rejects both happen.
+* After every OSThread_start() the ranks, the RM ready rings and
+* OS_rmReadySet (under EDF, the heap) must match a rebuild from scratch.
+*
+* SPDX-License-Identifier: GPL-3.0-or-later
+****************************************************************************/
+#include "test.h"
+
+extern OSThread *OS_thread[32 + 1];
+#if OS_SCHED_POLICY == OS_SCHED_EDF
+#define TEST_NAME "ranks (EDF)"
+extern OSHeapEntry OS_edfHeap[32];
+extern uint32_t OS_edfCount;
+extern uint8_t OS_edfIndex[32 + 1];
+#else
+#define TEST_NAME "ranks (RM)"
+extern OSThread *OS_rmThread[32 + 1];
+extern uint32_t OS_rmReadySet;
+#endif
+
+static OSThread l_thread[32];
+
+/* the rank by its definition: one more than the threads it precedes */
+static uint8_t bruteRank(OSThread const *me) {
+    uint8_t rank = 1U;
+    for (uint32_t i = 1U; i < 33U; i++) {
+        OSThread const *t = OS_thread[i];
+        if (t && (t != me)
+            && ((me->Di < t->Di) || ((me->Di == t->Di) && (me->Ti < t->Ti)))) {
+            ++rank;
+        }
+    }
+    return rank;
+}
+
+static void checkRanks(void) {
+    uint32_t active[32 + 1] = { 0U }; /* active threads, by rank */
+
+    for (uint32_t i = 1U; i < 33U; i++) {
+        OSThread const *t = OS_thread[i];
+        if (t) {
+            TEST_CHECK(t->rank == bruteRank(t));
+            TEST_CHECK(t->isActive); /* released when started */
+            ++active[t->rank];
+        }
+    }
+#if OS_SCHED_POLICY == OS_SCHED_EDF
+    {
+        uint32_t n = 0U;
+        for (uint32_t r = 1U; r < 33U; r++) {
+            n += active[r];
+        }
+        TEST_CHECK(OS_edfCount == n); /* every active job is in the heap */
+    }
+    for (uint32_t i = 0U; i < OS_edfCount; i++) {
+        OSHeapEntry const *e = &OS_edfHeap[i];
+        TEST_CHECK(OS_thread[e->slot] != (OSThread *)0);
+        TEST_CHECK(e->rank == OS_thread[e->slot]->rank);
+        TEST_CHECK(OS_edfIndex[e->slot] == i);
+        if (i > 0U) {
+            OSHeapEntry const *p = &OS_edfHeap[(i - 1U) / 2U];
+            TEST_CHECK(((int32_t)(p->key - e->key) < 0)
+                       || ((p->key == e->key) && (p->rank >= e->rank)));
+        }
+    }
+#else
+    for (uint32_t r = 1U; r < 33U; r++) {
+        OSThread const *head = OS_rmThread[r];
+        uint32_t n = 0U;
+        TEST_CHECK(((OS_rmReadySet >> (r - 1U)) & 1U) == (head != (OSThread *)0));
+        if (head != (OSThread *)0) {
+            OSThread const *t = head;
+            do {
+                TEST_CHECK(t->rank == r);
+                TEST_CHECK(t->rrNext->rrPrev == t);
+                ++n;
+                t = t->rrNext;
+            } while ((t != head) && (n <= 32U));
+        }
+        TEST_CHECK(n == active[r]);
+    }
+#endif
+}
+
+static void trial(unsigned seed) {
+    static uint32_t const periods[] = { 20U, 25U, 40U, 50U, 100U, 200U };
+    uint8_t order[32];
+    (void)seed;
+
+    for (uint32_t i = 0U; i < 32U; i++) {
+        order[i] = (uint8_t)(i + 1U);
+    }
+    for (uint32_t i = 31U; i > 0U; i--) { /* shuffle the prios */
+        uint32_t k = testRandom(0U, i);
+        uint8_t p = order[i];
+        order[i] = order[k];
+        order[k] = p;
+    }
+
+    testInit();
+    for (uint32_t i = 0U; i < 32U; i++) {
+        uint32_t T = periods[testRandom(0U, 5U)];
+        uint32_t D = (testRandom(0U, 2U) == 0U) ? (T - testRandom(0U, T / 2U)) : T;
+        uint32_t C = (testRandom(0U, 7U) == 0U) ? testRandom(1U, D) : 1U;
+        (void)testStart(&l_thread[order[i] - 1U], order[i], C, T, D);
+        checkRanks();
+    }
+}
+
+int main(void) {
+    return testTrials(TEST_NAME, 200U, &trial);
+}
@@ -0,0 +1,64 @@
+/****************************************************************************
+* Test of slack stealing (OS_SLACK_STEALING=1).
+*
+* Each trial starts 5 threads of random Ci, Ti and constrained Di, as far as
+* admission accepts them, and a stream of aperiodic jobs arriving at random.
+* Over ten hyperperiods, the aperiodic jobs must run ahead of pending
+* periodic work whenever there is slack, and still no periodic job may miss
+* its deadline. The tables are sized for up to 100 jobs per hyperperiod.
+*
+* SPDX-License-Identifier: GPL-3.0-or-later
+****************************************************************************/
+#include "test.h"
+
+#define N       5U
+#define HORIZON 2000U /* ten hyperperiods at most */
+#define JOBS    100U  /* within MAX_APERIODIC_TASKS */
+
+extern OSThread * volatile OS_curr;
+extern OSThread idleThread;
+
+static OSThread l_thread[N];
+static uint32_t l_stolen; /* aperiodic units run while periodic work waited */
+
+/* one unit of an aperiodic job, executed in the current tick */
+static void aperiodic(void) {
+    for (uint32_t i = 0U; i < N; i++) {
+        if ((OS_curr == &idleThread) && l_thread[i].isActive
+            && (l_thread[i].remainingTime != 0U)) {
+            ++l_stolen;
+            break;
+        }
+    }
+}
+
+int OS_simCheck(void) {
+    for (uint32_t i = 0U; i < N; i++) {
+        TEST_CHECK(l_thread[i].deadlineMisses == 0U);
+    }
+    TEST_CHECK(l_stolen != 0U); /* the aperiodic jobs did go first */
+    return 0;
+}
+
+static void trial(unsigned seed) {
+    static uint32_t const periods[] = { 10U, 20U, 25U, 40U, 50U, 100U };
+    uint32_t t = 0U;
+    (void)seed;
+
+    testInit();
+    for (uint32_t i = 0U; i < N; i++) {
+        uint32_t T = periods[testRandom(0U, 5U)];
+        uint32_t D = (testRandom(0U, 2U) == 0U) ? (T - testRandom(0U, T / 2U - 1U)) : T;
+        uint32_t C = testRandom(1U, T / 4U);
+        (void)testStart(&l_thread[i], (uint8_t)(i + 1U), (C < D) ? C : D, T, D);
+    }
+    for (uint32_t i = 0U; i < JOBS; i++) {
+        t += testRandom(0U, 40U);
+        TEST_CHECK(addAperiodicTask(&aperiodic, t, testRandom(1U, 15U)));
+    }
+    testRun(HORIZON);
+}
+
+int main(void) {
+    return testTrials("slack", 300U, &trial);
+}
@@ -0,0 +1,88 @@
+/****************************************************************************
+* Test of the Sporadic Server (OS_sporadicServerStart()).
+*
+* Each trial starts a server of random Cs/Ts next to a periodic thread, and
+* feeds it random bursts of aperiodic jobs. The job handler notes every tick
+* in which the server executes (what it leaves is served in background, in
+* the idle ticks). The server must never execute more than Cs ticks in any
+* window of Ts ticks, whatever the size of its replenishment list (the test
+* is built with OS_SS_REPL_MAX = 8, 2 and 1), each activation must end
+* within Ts, its deadline, and every aperiodic job must be served.
+*
+* SPDX-License-Identifier: GPL-3.0-or-later
+****************************************************************************/
+#include "test.h"
+
+#define HORIZON 6000U
+#define JOBS    100U /* within MAX_APERIODIC_TASKS */
+
+extern OSThread * volatile OS_curr;
+extern uint32_t volatile OSTotalTicks;
+extern uint32_t aperiodicTaskCount;
+
+static OSThread l_periodic;
+static OSThread l_server;
+static uint32_t l_serverStack[64];
+static uint32_t l_Cs, l_Ts;
+
+static uint32_t l_served[HORIZON]; /* the ticks the server executed, in order */
+static uint32_t l_servedCount;
+
+/* one unit of an aperiodic job, executed in the current tick */
+static void aperiodic(void) {
+    if (OS_curr == &l_server) {
+        TEST_CHECK(l_servedCount < HORIZON);
+        l_served[l_servedCount++] = OSTotalTicks;
+    }
+}
+
+int OS_simCheck(void) {
+    TEST_CHECK(aperiodicTaskCount == 0U); /* all served */
+    TEST_CHECK(l_servedCount != 0U);
+    TEST_CHECK(l_periodic.deadlineMisses == 0U);
+    TEST_CHECK(l_server.deadlineMisses == 0U); /* each activation within Ts */
+    for (uint32_t i = 0U; i < l_servedCount; i++) {
+        uint32_t n = 0U; /* ticks executed in [l_served[i], l_served[i] + Ts) */
+        for (uint32_t k = i; (k < l_servedCount) && (l_served[k] < l_served[i] + l_Ts); k++) {
+            ++n;
+        }
+        TEST_CHECK((i == 0U) || (l_served[i] > l_served[i - 1U]));
+        TEST_CHECK(n <= l_Cs);
+    }
+    return 0;
+}
+
+static void trial(unsigned seed) {
+    uint32_t t = 0U;
+    uint32_t jobs = 0U;
+    (void)seed;
+
+    l_Cs = testRandom(1U, 4U);
+    l_Ts = testRandom(2U * l_Cs, 16U);
+
+    testInit();
+    TEST_CHECK(testStart(&l_periodic, 1U, 20U, 150U, 150U));
+    TEST_CHECK(OS_sporadicServerStart(&l_server, 3U, l_serverStack,
+                                      sizeof(l_serverStack), l_Cs, l_Ts));
+    while ((t < HORIZON / 4U) && (jobs < JOBS)) {
+        /* a burst, of jobs arriving together or close */
+        uint32_t n = testRandom(1U, 8U);
+        if (n > JOBS - jobs) {
+            n = JOBS - jobs;
+        }
+        jobs += n;
+        t += testRandom(1U, 4U * l_Ts);
+        for (uint32_t i = 0U; i < n; i++) {
+            TEST_CHECK(addAperiodicTask(&aperiodic, t + testRandom(0U, 2U),
+                                        testRandom(1U, 2U * l_Cs)));
+        }
+    }
+    testRun(HORIZON);
+}
+
+int main(void) {
+    char name[32];
+    snprintf(name, sizeof(name), "sporadic (OS_SS_REPL_MAX=%u)",
+             (unsigned)OS_SS_REPL_MAX);
+    return testTrials(name, 200U, &trial);
+}
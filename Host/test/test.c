@@ -0,0 +1,64 @@
+/****************************************************************************
+* Support for the host test programs of MiROS.
+*
+* SPDX-License-Identifier: GPL-3.0-or-later
+****************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "miros.h"
+#include "test.h"
+
+/* the simulator never executes the threads, nor uses their stacks */
+static uint32_t l_stack[64];
+
+static void threadMain(void) {
+}
+
+int testTrials(char const *name, unsigned n, void (*trial)(unsigned seed)) {
+    unsigned failed = 0U;
+    for (unsigned seed = 1U; seed <= n; seed++) {
+        int status;
+        pid_t pid;
+        fflush(stdout);
+        pid = fork();
+        if (pid == 0) {
+            if (freopen("/dev/null", "w", stdout) == (FILE *)0) {
+                exit(2);
+            }
+            srand(seed);
+            trial(seed);
+            exit(0);
+        }
+        if ((pid < 0) || (waitpid(pid, &status, 0) != pid)
+            || !WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+            fprintf(stderr, "%s: trial %u failed\n", name, seed);
+            ++failed;
+        }
+    }
+    printf("%s: %u trials, %u failed\n", name, n, failed);
+    return (failed == 0U) ? 0 : 1;
+}
+
+void testInit(void) {
+    OS_init(l_stack, sizeof(l_stack));
+}
+
+bool testStart(OSThread *t, uint8_t prio, uint32_t C, uint32_t T, uint32_t D) {
+    return OSThread_startDeadline(t, prio, &threadMain, l_stack, sizeof(l_stack),
+                                  C, T, D);
+}
+
+void testRun(uint32_t ticks) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u", (unsigned)ticks);
+    setenv("MIROS_TICKS", buf, 1);
+    OS_run();
+}
+
+uint32_t testRandom(uint32_t lo, uint32_t hi) {
+    return lo + (uint32_t)rand() % (hi - lo + 1U);
+}
@@ -0,0 +1,50 @@
+/****************************************************************************
+* Support for the host test programs of MiROS.
+*
+* A test program links the unmodified kernel with the simulator port. Each
+* trial runs in a child process, so that it starts from a fresh kernel, and
+* either returns its verdict from main() or, when it calls OS_run(), from
+* OS_simCheck() once the simulator is done.
+*
+* SPDX-License-Identifier: GPL-3.0-or-later
+****************************************************************************/
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "miros.h"
+
+/* fail the current trial with a message */
+#define TEST_CHECK(cond_) do { \
+    if (!(cond_)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond_); \
+        exit(1); \
+    } \
+} while (0)
+
+/* run trial(seed) for the seeds 1..n, each in a child process with its
+* stdout (the simulator's report) discarded; returns the exit status of
+* the test program: 0 when every trial passed
+*/
+int testTrials(char const *name, unsigned n, void (*trial)(unsigned seed));
+
+/* OS_init() with a stack for the idle thread */
+void testInit(void);
+
+/* start a periodic thread that the simulator runs for C ticks every T,
+* with the relative deadline D; false if admission rejects it
+*/
+bool testStart(OSThread *t, uint8_t prio, uint32_t C, uint32_t T, uint32_t D);
+
+/* simulate the first ticks of the application started so far; does not
+* return, the verdict of the trial is the value of OS_simCheck()
+*/
+void testRun(uint32_t ticks);
+
+/* a random number in [lo, hi] */
+uint32_t testRandom(uint32_t lo, uint32_t hi);
+
+#endif /* TEST_H */
@@ -34,23 +34,84 @@
 
 #include <stdbool.h>
 
-/* Thread Control Block (TCB) */
+/* timing record of one completed job, all in ticks */
+typedef struct {
+    uint32_t release;  /* tick at which the job was released */
+    uint32_t start;    /* tick at which it was first dispatched */
+    uint32_t finish;   /* tick at whose end it completed */
+    uint32_t response; /* finish - release */
+    uint32_t deadline; /* absolute deadline, release + Di */
+    bool missed;       /* completed after its deadline */
+} OSJobRecord;
+
+#ifndef OS_JOB_LOG_SIZE
+#define OS_JOB_LOG_SIZE 8U /* records kept per thread, a power of 2 */
+#endif
+
+/* per-thread job log: the last OS_JOB_LOG_SIZE jobs and running statistics.
+ * Only completed jobs are counted, so a debugger can watch it live. */
 typedef struct {
+    OSJobRecord ring[OS_JOB_LOG_SIZE]; /* job n goes to ring[n % OS_JOB_LOG_SIZE] */
+    uint32_t count; /* completed jobs */
+    uint32_t minResponse;
+    uint32_t maxResponse;
+    uint64_t sumResponse; /* the mean is sumResponse / count, see OS_jobMeanResponse() */
+    bool started; /* the current job has been dispatched */
+} OSJobLog;
+
+struct OSThread;
+typedef void (*OSOverrunHook)(struct OSThread *t);
+
+/* Thread Control Block (TCB) */
+typedef struct OSThread {
     void *sp; /* stack pointer */
-    uint32_t timeout; /* timeout delay down-counter */
+    uint32_t timeout; /* timeout delay, relative to the previous delayed thread */
+    struct OSThread *timeoutNext; /* next thread in the timeout delta list */
     uint8_t prio; /* thread priority */
     /* ... other attributes associated with a thread */
     uint32_t Ci;
     uint32_t Ti;
+    uint32_t Di; /* relative deadline, Di <= Ti */
     uint32_t startupTi;
     uint32_t remainingTime;
     bool isActive;
+    uint8_t rank; /* RM rank, the higher the more urgent; equal Di and Ti share one */
+    uint32_t deadline; /* absolute deadline of the current job */
+    uint32_t deadlineMisses; /* jobs completed late or not at all */
+    uint32_t Ri; /* worst-case response time found at admission, 0 if unknown */
+    OSJobLog jobLog; /* timing of the last jobs */
+    uint32_t budget; /* capacity left to an aperiodic server [ticks] */
+    uint32_t execUs; /* execution time charged to the current job [us] */
+    uint32_t overruns; /* jobs that exhausted their budget */
+    uint8_t overrunAction; /* OS_OVERRUN_SUSPEND or OS_OVERRUN_DEMOTE */
+    OSOverrunHook overrunHook; /* called from the tick ISR on each overrun */
+    bool demoted; /* the current job overran and runs only in background */
+    uint32_t timeSlice; /* round-robin slice among threads of equal rank [ticks] */
+    uint32_t sliceLeft; /* ticks left in the current slice */
+    struct OSThread *rrNext; /* ring of the ready threads of equal rank */
+    struct OSThread *rrPrev;
 } OSThread;
 
+/* entry of the kernel's release and EDF heaps: the key is stored inline, so
+ * the heaps never dereference the thread while comparing */
+typedef struct {
+    uint32_t key; /* release instant or absolute deadline [ticks] */
+    uint8_t slot; /* the thread's prio, index into OS_thread[] */
+    uint8_t rank; /* its RM rank, to break EDF ties */
+} OSHeapEntry;
+
+/* entry of the cyclic-executive dispatch table: from time on, in ticks into
+ * the hyperperiod, the thread of priority prio runs (0 is the idle thread) */
+typedef struct {
+    uint32_t time;
+    uint8_t prio;
+} OSDispatchEntry;
+
 typedef struct {
 	void (*taskHandler)(void);  // The function to execute
     uint32_t arrivalTime;        // Time at which the task should be executed
     uint32_t remainingCost;     // The cost (remaining time to execute)
+    uint32_t id;                // Order of the addAperiodicTask() calls, breaks arrival ties
 } AperiodicTask;
 
 typedef struct {
@@ -59,7 +120,80 @@ typedef struct {
 } semaphore;
 
 #define TICKS_PER_SEC 100U
-#define MAX_APERIODIC_TASKS 10  // Maximum number of aperiodic tasks that can be handled
+#define OS_TICK_US (1000000U / TICKS_PER_SEC) /* length of a tick [us] */
+
+/* scheduling policy of the periodic threads, selected at build time */
+#define OS_SCHED_RM  0 /* Rate/Deadline Monotonic: fixed priorities from Di */
+#define OS_SCHED_EDF 1 /* Earliest Deadline First: deadline = release + Di */
+#define OS_SCHED_TABLE 2 /* cyclic executive: dispatch table in miros_table.c */
+#ifndef OS_SCHED_POLICY
+#define OS_SCHED_POLICY OS_SCHED_RM
+#endif
+
+/* tickless idle: instead of taking every SysTick, the idle thread programs
+ * a single timer interrupt for the next scheduler event and sleeps */
+#ifndef OS_TICKLESS
+#define OS_TICKLESS 0
+#endif
+
+/* threads with equal Di and Ti share an RM rank and are time-sliced
+ * round-robin, by default every OS_TIME_SLICE ticks */
+#ifndef OS_TIME_SLICE
+#define OS_TIME_SLICE 1U
+#endif
+
+/* budget enforcement: what happens to a job still running when the kernel
+ * has charged it more than Ci ticks of execution */
+#define OS_OVERRUN_SUSPEND 0U /* it is suspended until its next release */
+#define OS_OVERRUN_DEMOTE  1U /* it goes on only in background, when idle */
+#ifndef OS_OVERRUN_ACTION
+#define OS_OVERRUN_ACTION OS_OVERRUN_SUSPEND
+#endif
+/* tolerance on the budget, in us: a job that uses all its Ci is still
+ * running when the tick ending its last tick is charged, give or take the
+ * jitter of that interrupt */
+#ifndef OS_BUDGET_MARGIN_US
+#define OS_BUDGET_MARGIN_US (OS_TICK_US / 2U)
+#endif
+
+/* admission control: bound on the longest critical section of any thread,
+ * in ticks, charged to every thread as NPP blocking */
+#ifndef OS_ADMIT_BLOCKING
+#define OS_ADMIT_BLOCKING 1U
+#endif
+/* capacity of the aperiodic queue, a min-heap by arrival: the jobs added
+ * and not yet finished, 16 bytes each */
+#ifndef MAX_APERIODIC_TASKS
+#define MAX_APERIODIC_TASKS 128U
+#endif
+
+/* aperiodic server serving the aperiodic jobs at an RM priority; whatever
+ * it leaves over is still served in background, when the CPU is idle */
+#define OS_SERVER_NONE    0U /* Background Server only */
+#define OS_SERVER_POLLING 1U /* Polling Server, see OS_pollingServerStart() */
+#define OS_SERVER_DEFERRABLE 2U /* Deferrable Server, see OS_deferrableServerStart() */
+#define OS_SERVER_SPORADIC 3U /* Sporadic Server, see OS_sporadicServerStart() */
+#define OS_SERVER_TBS     4U /* Total Bandwidth Server, see OS_tbsServerStart() */
+#define OS_SERVER_CBS     5U /* Constant Bandwidth Server, see OS_cbsServerStart() */
+
+/* slack stealing: the aperiodic jobs run at once, ahead of the periodic
+ * threads, while the slack tables that OS_run() builds for the static RM/DM
+ * thread set show that no periodic job can miss its deadline. RM/DM only,
+ * without an aperiodic server; the threads must all be started at the same
+ * tick, before OS_run(). */
+#ifndef OS_SLACK_STEALING
+#define OS_SLACK_STEALING 0
+#endif
+
+/* capacity of the slack tables: the jobs of all threads in a hyperperiod */
+#ifndef OS_SLACK_JOBS
+#define OS_SLACK_JOBS 64U
+#endif
+
+/* pending capacity replenishments of the Sporadic Server */
+#ifndef OS_SS_REPL_MAX
+#define OS_SS_REPL_MAX 8U
+#endif
 
 typedef void (*OSThreadHandler)();
 
@@ -77,22 +211,158 @@ void OS_run();
 /* blocking delay */
 void OS_delay(uint32_t ticks);
 
+/* finish the current job and block until the next release */
+void OS_waitNextPeriod(void);
+
 /* process all timeouts */
 void OS_tick(void);
 
+/* events that can change the scheduling decision. They are raised by the
+ * kernel, and by OS_tick() for the tick that just started; the tick ISR
+ * calls OS_sched() only when one is pending, and OS_sched() clears them. */
+#define OS_EVT_RELEASE   (1U << 0) /* a job was released, or is due */
+#define OS_EVT_COMPLETE  (1U << 1) /* a job completed */
+#define OS_EVT_OVERRUN   (1U << 2) /* a job exhausted its budget */
+#define OS_EVT_SLICE     (1U << 3) /* a round-robin slice ended */
+#define OS_EVT_TIMEOUT   (1U << 4) /* an OS_delay() expired */
+#define OS_EVT_SEM       (1U << 5) /* a semaphore was taken or given */
+#define OS_EVT_APERIODIC (1U << 6) /* the Background Server has work, or finished a job */
+#define OS_EVT_DISPATCH  (1U << 7) /* the next entry of the dispatch table is due */
+extern uint32_t volatile OS_schedEvents;
+
+/* tickless idle support: ticks until the next scheduler event, and
+ * accounting of the ticks skipped while sleeping */
+uint32_t OS_nextEventTicks(void);
+void OS_tickAnnounce(uint32_t ticks);
+
 /* callback to configure and start interrupts */
 void OS_onStartup(void);
 
-void OSThread_start(
+/* free-running 64-bit microsecond clock, independent of the tick rate;
+ * OS_clockUs() is lock-free and can be called from threads and ISRs */
+void OS_clockInit(void);
+uint64_t OS_clockUs(void);
+
+/* both return false, without starting the thread, when admitting it would
+ * make the thread set unschedulable */
+bool OSThread_start(
     OSThread *me,
     uint8_t prio, /* thread priority */
     OSThreadHandler threadHandler,
     void *stkSto, uint32_t stkSize,
 	uint32_t Ci, uint32_t Ti);
 
+/* like OSThread_start(), with a constrained relative deadline Di <= Ti;
+ * priorities then follow the Deadline Monotonic order */
+bool OSThread_startDeadline(
+    OSThread *me,
+    uint8_t prio, /* thread priority */
+    OSThreadHandler threadHandler,
+    void *stkSto, uint32_t stkSize,
+	uint32_t Ci, uint32_t Ti, uint32_t Di);
+
+/* hash of the prio, Ci, Ti and Di of the threads started so far; a dispatch
+ * table is only valid for the thread set it was generated from */
+uint32_t OS_taskSetSignature(void);
+
+/* Polling Server: a periodic thread of capacity Cs ticks every Ts ticks,
+ * admitted and scheduled like any other, that executes the aperiodic jobs,
+ * one unit per tick it runs. A server job that finds no aperiodic job at its
+ * release, or that empties the queue, gives up the rest of its capacity
+ * until the next period. Only one server can be started. */
+bool OS_pollingServerStart(
+    OSThread *me,
+    uint8_t prio, /* thread priority */
+    void *stkSto, uint32_t stkSize,
+    uint32_t Cs, uint32_t Ts);
+
+/* Deferrable Server: like the Polling Server, but the capacity left when
+ * the queue empties is kept until the end of the period, and the server is
+ * ready again as soon as an aperiodic job arrives. It can then run at the
+ * end of one period and at the start of the next, which OS_interference()
+ * charges to the lower priority threads. Fixed priorities only (RM/DM). */
+bool OS_deferrableServerStart(
+    OSThread *me,
+    uint8_t prio, /* thread priority */
+    void *stkSto, uint32_t stkSize,
+    uint32_t Cs, uint32_t Ts);
+
+/* Sporadic Server: the capacity is not refilled every period. The capacity
+ * an activation uses, from the moment the server gets ready with aperiodic
+ * work to the moment it is done, is given back Ts ticks after that moment,
+ * through a list of at most OS_SS_REPL_MAX pending replenishments. It never
+ * demands more than Cs in any Ts, so it is analysed like a periodic thread.
+ * Fixed priorities only (RM/DM). */
+bool OS_sporadicServerStart(
+    OSThread *me,
+    uint8_t prio, /* thread priority */
+    void *stkSto, uint32_t stkSize,
+    uint32_t Cs, uint32_t Ts);
+
+/* Total Bandwidth Server: the bandwidth Us = Cs/Ts is reserved at
+ * admission, and each aperiodic job, served in arrival order, becomes a job
+ * of the server with the deadline max(arrival, previous deadline) + cost/Us,
+ * scheduled by EDF with the periodic jobs. The cost given to
+ * addAperiodicTask() is trusted. EDF only. */
+bool OS_tbsServerStart(
+    OSThread *me,
+    uint8_t prio, /* thread priority */
+    void *stkSto, uint32_t stkSize,
+    uint32_t Cs, uint32_t Ts);
+
+/* Constant Bandwidth Server: a budget of Cs ticks with a deadline. An
+ * arrival at r that finds the server idle keeps the budget and deadline
+ * only if budget <= (deadline - r) * Cs/Ts, else it gets a full budget and
+ * the deadline r + Ts. An exhausted budget is refilled and the deadline
+ * postponed by Ts, so the aperiodic jobs never get more than Cs/Ts of the
+ * CPU, whatever their cost. EDF only. */
+bool OS_cbsServerStart(
+    OSThread *me,
+    uint8_t prio, /* thread priority */
+    void *stkSto, uint32_t stkSize,
+    uint32_t Cs, uint32_t Ts);
+
+/* most execution time the thread can demand in any window of the given
+ * ticks, the interference term of the response-time analysis: ceil(w/Ti)*Ci,
+ * or ceil((w + Ts - Cs)/Ts)*Cs for a Deferrable Server */
+uint32_t OS_interference(OSThread const *h, uint32_t window);
+
+/* slack stealing: ticks of aperiodic work that can run now, ahead of every
+ * periodic thread, without making a periodic job miss its deadline */
+uint32_t OS_slackAvailable(void);
+
+/* round-robin time slice of the thread among the ones of equal rank */
+void OSThread_setTimeSlice(OSThread *me, uint32_t ticks);
+
+/* per-thread overrun action and optional hook (0 for none) */
+void OSThread_setOverrun(OSThread *me, uint8_t action, OSOverrunHook hook);
+
+/* job bookkeeping: release a new job / retire the current one */
+void OS_jobRelease(OSThread *t);
+void OS_jobComplete(OSThread *t);
+
+/* charge a thread us microseconds of execution and enforce its budget; the
+ * kernel charges the running thread the time measured with OS_clockUs() at
+ * every tick and every scheduling decision */
+void OS_budgetCharge(OSThread *t, uint32_t us);
+
+/* copy the record of the age-th most recent completed job (0 = the last);
+ * returns false if there is no such record */
+bool OS_jobRecordGet(OSThread const *t, uint32_t age, OSJobRecord *rec);
+
+/* mean response time of the completed jobs, 0 if there are none; the
+ * division is left to the reader so that the tick ISR does not pay it */
+uint32_t OS_jobMeanResponse(OSThread const *t);
+
+/* simulate remainingTime ticks of work of the current job; the job is then
+ * finished by OS_waitNextPeriod() */
 void TaskAction(OSThread *task, uint32_t remainingTime, uint32_t *counterVisualizer);
 
-void addAperiodicTask(void (*taskFunction)(void), uint32_t arrivalTime, uint32_t cost);
+/* queue an aperiodic job of the given cost, in ticks, arriving at the given
+ * tick, in O(log n); it can be called before OS_run() or at run time by a
+ * thread, an ISR or an aperiodic job's handler, with interrupts enabled or
+ * not. Returns false, dropping the job, when the queue is full. */
+bool addAperiodicTask(void (*taskFunction)(void), uint32_t arrivalTime, uint32_t cost);
 
 void sem_init(semaphore* s, int32_t init_value);
 
@@ -0,0 +1,64 @@
+/****************************************************************************
+* MInimal Real-time Operating System (MiROS), GNU-ARM port interface.
+* version 1.26 (matching lesson 26, see https://youtu.be/kLxxXNCrY60)
+*
+* This software is a teaching aid to illustrate the concepts underlying
+* a Real-Time Operating System (RTOS). The main goal of the software is
+* simplicity and clear presentation of the concepts, but without dealing
+* with various corner cases, portability, or error handling. For these
+* reasons, the software is generally NOT intended or recommended for use
+* in commercial applications.
+*
+* Copyright (C) 2018 Miro Samek. All Rights Reserved.
+*
+* SPDX-License-Identifier: GPL-3.0-or-later
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*
+* Git repo:
+* https://github.com/QuantumLeaps/MiROS
+****************************************************************************/
+#ifndef MIROS_PORT_H
+#define MIROS_PORT_H
+
+#include "stm32f1xx.h"
+
+/* interrupt disabling/enabling around the kernel critical sections */
+#define OS_INT_DISABLE()   __disable_irq()
+#define OS_INT_ENABLE()    __enable_irq()
+
+/* critical section callable with interrupts enabled or disabled (from a
+ * thread, an ISR or another critical section): PRIMASK is saved and restored */
+#define OS_INT_SAVE(st_)   do { (st_) = __get_PRIMASK(); __disable_irq(); } while (0)
+#define OS_INT_RESTORE(st_) __set_PRIMASK(st_)
+
+/* request a context switch to OS_next by pending the PendSV exception
+ * DSB - whenever a memory access needs to have completed before program execution progresses.
+ * ISB - whenever instruction fetches need to explicitly take place after a certain point in the program,
+ * for example after memory map updates or after writing code to be executed.
+ * (In practice, this means "throw away any prefetched instructions at this point".)
+ */
+#define OS_TRIGGER_PENDSV() do {                 \
+    SCB->ICSR |= SCB_ICSR_PENDSVSET_Msk;         \
+    __asm volatile("dsb");                       \
+} while (0)
+
+/* port-specific part of OS_init() */
+void OS_portInit(void);
+
+/* build the initial stack frame of a thread and store its top in me->sp */
+void OS_portThreadInit(OSThread *me, OSThreadHandler threadHandler,
+                       void *stkSto, uint32_t stkSize);
+
+#endif /* MIROS_PORT_H */
@@ -55,7 +55,9 @@ void SVC_Handler(void);
 void DebugMon_Handler(void);
 void PendSV_Handler(void);
 void SysTick_Handler(void);
+void TIM3_IRQHandler(void);
 /* USER CODE BEGIN EFP */
+void OS_clockIsr(void);
 
 /* USER CODE END EFP */
 
@@ -16,16 +16,27 @@ int32_t resource = 0;
 // Variables that will be used to simulate heavy computation
 volatile int counter, j;
 
-// Stack arrays for the tasks
-uint32_t stackTask1[40];
-uint32_t stackTask2[40];
-uint32_t stackTask3[40];
-uint32_t stack_idleThread[40];
+// Aperiodic service: 0 = Background Server only, 1 = Polling Server,
+// 2 = Deferrable Server, 3 = Sporadic Server; under EDF (OS_SCHED_POLICY
+// set to OS_SCHED_EDF) 4 = Total Bandwidth Server, 5 = Constant Bandwidth Server
+#ifndef APERIODIC_SERVER
+#define APERIODIC_SERVER 0
+#endif
+
+// Stack arrays for the tasks. The SysTick and PendSV run on the stack of
+// the thread they interrupt, so each one must also hold the deepest path
+// through OS_tick() and OS_sched() (slack stealing, EDF heap, servers)
+uint32_t stackTask1[128];
+uint32_t stackTask2[128];
+uint32_t stackTask3[128];
+uint32_t stackServer[128];
+uint32_t stack_idleThread[128];
 
 // Thread control blocks
 OSThread task1Thread;
 OSThread task2Thread;
 OSThread task3Thread;
+OSThread serverThread;
 
 // Prototypes
 void task1();
@@ -49,6 +60,33 @@ int main() {
     OSThread_start(&task3Thread, 1U, &task3, stackTask3, sizeof(stackTask3),
                    1 * TICKS_PER_SEC, 10 * TICKS_PER_SEC);
 
+#if APERIODIC_SERVER == 1
+    // Polling Server with Cs = 0.25 and Ts = 2.5: the shortest period, so
+    // the highest RM priority, and the set stays schedulable
+    OS_pollingServerStart(&serverThread, 4U, stackServer, sizeof(stackServer),
+                          TICKS_PER_SEC / 4, 5 * TICKS_PER_SEC / 2);
+#elif APERIODIC_SERVER == 2
+    // Deferrable Server with Cs = 0.2 and Ts = 2.5: it interferes more than
+    // a periodic thread, so less capacity fits than for the Polling Server
+    OS_deferrableServerStart(&serverThread, 4U, stackServer, sizeof(stackServer),
+                             TICKS_PER_SEC / 5, 5 * TICKS_PER_SEC / 2);
+#elif APERIODIC_SERVER == 3
+    // Sporadic Server with the capacity of the Polling Server: it is
+    // analysed like a periodic thread, yet serves arrivals at once
+    OS_sporadicServerStart(&serverThread, 4U, stackServer, sizeof(stackServer),
+                           TICKS_PER_SEC / 4, 5 * TICKS_PER_SEC / 2);
+#elif APERIODIC_SERVER == 4
+    // Total Bandwidth Server with Us = 0.25 / 2.5 = 0.1: each aperiodic job
+    // gets the deadline of running at a tenth of the CPU
+    OS_tbsServerStart(&serverThread, 4U, stackServer, sizeof(stackServer),
+                      TICKS_PER_SEC / 4, 5 * TICKS_PER_SEC / 2);
+#elif APERIODIC_SERVER == 5
+    // Constant Bandwidth Server with the same bandwidth, enforced as a
+    // budget of 0.25 per deadline of 2.5
+    OS_cbsServerStart(&serverThread, 4U, stackServer, sizeof(stackServer),
+                      TICKS_PER_SEC / 4, 5 * TICKS_PER_SEC / 2);
+#endif
+
     // Aperiodic task with arrival at T = 1 and cost of C = 1
     addAperiodicTask(aperiodicTask, 1 * TICKS_PER_SEC, 1 * TICKS_PER_SEC);
 
@@ -66,12 +104,14 @@ void task1() {
         resource = resource + 5;
     	sem_post(&mutex, &task1Thread);
         TaskAction(&task1Thread, task1Thread.remainingTime, &task1Visualizer);
+        OS_waitNextPeriod();
     }
 }
 
 void task2() {
     while (1) {
         TaskAction(&task2Thread, task2Thread.remainingTime, &task2Visualizer);
+        OS_waitNextPeriod();
     }
 }
 
@@ -85,6 +125,7 @@ void task3() {
         resource = resource - 5;
         sem_post(&mutex, &task3Thread);
         TaskAction(&task3Thread, task3Thread.remainingTime, &task3Visualizer);
+        OS_waitNextPeriod();
     }
 }
 
@@ -33,8 +33,8 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include "miros.h"
+#include "miros_port.h"
 #include "qassert.h"
-#include "stm32f1xx.h"
 
 Q_DEFINE_THIS_FILE
 
@@ -44,8 +44,11 @@ OSThread * volatile OS_next; /* pointer to the next thread to run */
 OSThread *OS_thread[32 + 1]; /* array of threads started so far */
 uint32_t OS_readySet; /* bitmask of threads that are ready to run */
 uint32_t OS_delayedSet; /* bitmask of threads that are delayed */
+OSThread *OS_timeoutList; /* delayed threads, sorted, timeouts as deltas */
 
-uint32_t OSTotalTicks; // Total number of ticks counter
+uint32_t volatile OSTotalTicks; // Total number of ticks counter
+uint32_t volatile OS_schedEvents; /* OS_EVT_... pending since the last OS_sched() */
+static uint64_t OS_chargeStamp; /* OS_clockUs() when OS_curr was last charged */
 
 #define LOG2(x)        (32U - __builtin_clz(x))
 #define ARRAY_SIZE(x)  (sizeof(x) / sizeof((x)[0]))
@@ -53,29 +56,147 @@ uint32_t OSTotalTicks; // Total number of ticks counter
 uint32_t const MAX_VAL = UINT32_MAX;
 
 
-AperiodicTask aperiodicTaskQueue[MAX_APERIODIC_TASKS];
+AperiodicTask aperiodicTaskQueue[MAX_APERIODIC_TASKS]; /* min-heap by arrival, then id */
 uint32_t aperiodicTaskCount = 0;
+uint32_t aperiodicTaskNextId = 0; /* id of the next job added */
+
+OSThread *OS_rmThread[32 + 1]; /* by RM rank: ring of the threads with an active job, head runs */
+uint32_t OS_rmReadySet; /* bitmask of RM ranks with an active job */
+
+/* Hot scheduling state, kept out of the OSThread structs: the heaps hold
+* their keys inline, next to the thread's slot (prio), and the per-thread
+* values they need are packed in arrays indexed by the slot. Comparing and
+* moving heap entries then never dereferences an OSThread.
+*/
+uint32_t OS_period[32 + 1]; /* Ti, by slot */
+#if OS_SCHED_POLICY == OS_SCHED_EDF
+OSHeapEntry OS_edfHeap[32]; /* min-heap of active jobs keyed by deadline */
+uint32_t OS_edfCount; /* number of jobs in OS_edfHeap */
+uint8_t OS_edfIndex[32 + 1]; /* position in OS_edfHeap, by slot */
+#endif
+
+#if OS_SCHED_POLICY == OS_SCHED_TABLE
+/* the dispatch table, generated by the host simulator (make -C Host table) */
+extern OSDispatchEntry const OS_dispatchTable[];
+extern uint32_t const OS_dispatchCount;
+extern uint32_t const OS_dispatchHyperperiod;
+extern uint32_t const OS_dispatchSignature;
+
+uint32_t OS_dispatchIndex; /* entry in effect */
+uint32_t OS_dispatchFrame; /* tick at which the current hyperperiod began */
+uint32_t OS_dispatchNext;  /* tick at which the next entry takes effect */
+#define OS_DISPATCHED()  (OS_thread[OS_dispatchTable[OS_dispatchIndex].prio])
+#endif
+
+OSThread *OS_nppOwner; /* thread holding a semaphore under the NPP */
+OSThread *OS_server; /* the aperiodic server thread, 0 if none */
+uint8_t OS_serverType; /* OS_SERVER_... */
+
+/* the Total and Constant Bandwidth Servers make EDF deadlines of their own
+* for the aperiodic jobs, from the bandwidth Cs/Ts, instead of being released
+*/
+#define OS_SERVER_BANDWIDTH() \
+    ((OS_serverType == OS_SERVER_TBS) || (OS_serverType == OS_SERVER_CBS))
+
+/* Sporadic Server: the replenishments, in time order (a ring, as each one
+* is due Ts after an activation that began after the previous ones)
+*/
+typedef struct {
+    uint32_t time; /* tick at which the capacity comes back */
+    uint32_t amount;
+} OSReplenishment;
+OSReplenishment OS_ssRepl[OS_SS_REPL_MAX];
+uint32_t OS_ssReplHead; /* oldest pending replenishment */
+uint32_t OS_ssReplCount;
+uint32_t OS_ssActivation; /* tick at which the current activation began */
+uint32_t OS_ssConsumed; /* capacity used since then */
+uint32_t OS_demotedSet; /* bitmask of threads whose overrunning job runs in background */
+
+#if OS_SLACK_STEALING
+/* Slack stealing (Lehoczky and Ramos-Thuel): for job j of each thread in
+* the hyperperiod, the table holds the level idle time in [0, D_ij] of the
+* schedule of the threads ranked at or above it, the most non-periodic time
+* the level can afford before that deadline. At run time the time already
+* lost to the level, neither spent on its periodic work, is subtracted.
+*/
+Q_ASSERT_STATIC(OS_SCHED_POLICY == OS_SCHED_RM);
+uint32_t OS_slackTable[OS_SLACK_JOBS];
+uint32_t OS_slackFirst[32 + 1]; /* first entry of each thread, by slot */
+uint32_t OS_slackHyperperiod; /* 0 until OS_run() builds the tables */
+uint32_t OS_slackFrame; /* tick at which the current hyperperiod began */
+uint32_t OS_slackWork[32 + 1]; /* periodic execution in it at each rank and above [us] */
+uint32_t OS_slackJob[32 + 1]; /* jobs released in it, by slot */
+#endif
+
+OSHeapEntry OS_releaseHeap[32]; /* min-heap of threads keyed by the next release */
+uint32_t OS_releaseCount; /* number of threads in OS_releaseHeap */
+
+/* admission control, in Q16.16 fixed point (no FPU on the target) */
+#define OS_Q16_ONE  (1UL << 16)
+#if OS_SCHED_POLICY == OS_SCHED_EDF
+uint32_t OS_admitLoad = 0U; /* total density sum(Ci / Di) */
+static uint32_t OS_admitLevel[32 + 1]; /* density of the deadline level of each thread, by prio */
+#else
+uint32_t OS_admitLoad = OS_Q16_ONE; /* hyperbolic product prod(1 + (Ci + B) / Di) */
+static uint32_t OS_admitR[32 + 1]; /* response times under test, by prio */
+#endif
+
+// Aperiodic jobs are served in arrival order, the ones arriving at the
+// same tick in the order they were added (arrivals compared modulo 2^32)
+static bool aperiodicTaskBefore(AperiodicTask const *a, AperiodicTask const *b) {
+    int32_t diff = (int32_t)(a->arrivalTime - b->arrivalTime);
+    return (diff < 0) || ((diff == 0) && ((int32_t)(a->id - b->id) < 0));
+}
 
-uint32_t lowestPeriodTask = 0; // lowest period = highest priority
-
-void addAperiodicTask(void (*taskHandler)(void), uint32_t arrivalTime, uint32_t cost) {
-    if (aperiodicTaskCount < MAX_APERIODIC_TASKS) {
-        aperiodicTaskQueue[aperiodicTaskCount].taskHandler = taskHandler;
-        aperiodicTaskQueue[aperiodicTaskCount].arrivalTime = arrivalTime;
-        aperiodicTaskQueue[aperiodicTaskCount].remainingCost = cost;
-        aperiodicTaskCount++;
-
-        // Sort the tasks by arrival time
-        for (uint32_t i = 0; i < aperiodicTaskCount - 1; i++) {
-            for (uint32_t j = i + 1; j < aperiodicTaskCount; j++) {
-                if (aperiodicTaskQueue[i].arrivalTime > aperiodicTaskQueue[j].arrivalTime) {
-                    AperiodicTask temp = aperiodicTaskQueue[i];
-                    aperiodicTaskQueue[i] = aperiodicTaskQueue[j];
-                    aperiodicTaskQueue[j] = temp;
-                }
-            }
+bool addAperiodicTask(void (*taskHandler)(void), uint32_t arrivalTime, uint32_t cost) {
+    AperiodicTask task;
+    uint32_t i;
+    uint32_t intState;
+
+    if (cost == 0U) {
+        return true; /* nothing to execute */
+    }
+    OS_INT_SAVE(intState); /* also called from ISRs and the job handlers */
+    if (aperiodicTaskCount == MAX_APERIODIC_TASKS) {
+        OS_INT_RESTORE(intState);
+        return false;
+    }
+    task.taskHandler = taskHandler;
+    task.arrivalTime = arrivalTime;
+    task.remainingCost = cost;
+    task.id = aperiodicTaskNextId++;
+
+    // Sift the new job up from the end of the heap
+    i = aperiodicTaskCount++;
+    while (i > 0U && aperiodicTaskBefore(&task, &aperiodicTaskQueue[(i - 1U) / 2U])) {
+        aperiodicTaskQueue[i] = aperiodicTaskQueue[(i - 1U) / 2U];
+        i = (i - 1U) / 2U;
+    }
+    aperiodicTaskQueue[i] = task;
+    OS_INT_RESTORE(intState);
+    return true;
+}
+
+// Remove the earliest job, the root of the heap, once it is finished
+static void aperiodicTaskPop(void) {
+    AperiodicTask last = aperiodicTaskQueue[--aperiodicTaskCount];
+    uint32_t i = 0U;
+    for (;;) {
+        uint32_t child = 2U * i + 1U;
+        if (child >= aperiodicTaskCount) {
+            break;
+        }
+        if (child + 1U < aperiodicTaskCount
+            && aperiodicTaskBefore(&aperiodicTaskQueue[child + 1U], &aperiodicTaskQueue[child])) {
+            child++;
+        }
+        if (!aperiodicTaskBefore(&aperiodicTaskQueue[child], &last)) {
+            break;
         }
+        aperiodicTaskQueue[i] = aperiodicTaskQueue[child];
+        i = child;
     }
+    aperiodicTaskQueue[i] = last;
 }
 
 
@@ -86,28 +207,47 @@ void main_idleThread() {
     }
 }
 
+// The earliest aperiodic job, if it has arrived, 0 if none: the root of the
+// heap, as every job in the queue still has work (O(1))
+static AperiodicTask *aperiodicTaskHead() {
+    if (aperiodicTaskCount != 0U
+        && (int32_t)(OSTotalTicks - aperiodicTaskQueue[0].arrivalTime) >= 0) {
+        return &aperiodicTaskQueue[0];
+    }
+    return (AperiodicTask *)0;
+}
+
+// Execute one unit (one tick) of the aperiodic job at the head. The unit is
+// accounted before the handler runs: a job the handler adds may become the
+// root of the heap.
+static void aperiodicTaskServe(AperiodicTask *task) {
+    void (*taskHandler)(void) = task->taskHandler;
+    Q_ASSERT(task == &aperiodicTaskQueue[0]);
+    task->remainingCost--;
+
+    // If the aperiodic task is done, it leaves the queue
+    if (task->remainingCost == 0) {
+        aperiodicTaskPop();
+        OS_schedEvents |= OS_EVT_APERIODIC; /* a demoted job may resume */
+    }
+    taskHandler();
+}
+
 // Function to execute the aperiodic tasks that are ready
 void executeAperiodicTasks() {
-    for (uint32_t i = 0; i < aperiodicTaskCount; i++) {
-        AperiodicTask *task = &aperiodicTaskQueue[i];
-
-        // If ready to execute (arrival time <= OSTotalTicks) and has remaining cost
-        if (task->arrivalTime <= OSTotalTicks && task->remainingCost > 0) {
-            // Check if no periodic task is running
-            if (OS_curr == &idleThread) {
-                task->taskHandler();
-                task->remainingCost--;
-
-                // If the aperiodic task is done, it will never arrive again
-                if (task->remainingCost == 0) {
-                    task->arrivalTime = MAX_VAL;
-                }
-                return;
-            }
-        }
+    AperiodicTask *task = aperiodicTaskHead();
+
+    // Check if no periodic task is running
+    if (task != (AperiodicTask *)0 && OS_curr == &idleThread) {
+        aperiodicTaskServe(task);
     }
 }
 
+// Is an aperiodic job waiting to be served?
+static bool aperiodicTaskPending() {
+    return aperiodicTaskHead() != (AperiodicTask *)0;
+}
+
 // Only execute aperiodic tasks when no periodic tasks are active (idle time)
 void checkForIdleAndAperiodicTasks() {
     if (OS_curr == &idleThread) {
@@ -116,66 +256,840 @@ void checkForIdleAndAperiodicTasks() {
 }
 
 
+#if OS_SCHED_POLICY == OS_SCHED_TABLE
+// Move to the next entry of the dispatch table, wrapping around at the end
+// of the hyperperiod
+static void OS_dispatchAdvance(void) {
+    if (++OS_dispatchIndex == OS_dispatchCount) {
+        OS_dispatchIndex = 0U;
+        OS_dispatchFrame += OS_dispatchHyperperiod;
+    }
+    OS_dispatchNext = OS_dispatchFrame
+        + ((OS_dispatchIndex + 1U < OS_dispatchCount)
+           ? OS_dispatchTable[OS_dispatchIndex + 1U].time
+           : OS_dispatchHyperperiod);
+}
+#endif
+
 void OS_init(void *stkSto, uint32_t stkSize) {
-    /* set the PendSV interrupt priority to the lowest level 0xFF */
-    *(uint32_t volatile *)0xE000ED20 |= (0xFFU << 16);
+    OS_portInit();
 
     /* start idleThread thread */
     OSThread_start(&idleThread, 0U, &main_idleThread, stkSto, stkSize, 0U, 0U);
 
     OSTotalTicks = 0;
+
+#if OS_SCHED_POLICY == OS_SCHED_TABLE
+    /* the first hyperperiod begins at tick 0, with the first entry */
+    OS_dispatchIndex = OS_dispatchCount - 1U;
+    OS_dispatchFrame = 0U - OS_dispatchHyperperiod;
+    OS_dispatchAdvance();
+#endif
 }
 
-void checkLowestPriorityThread(OSThread** lowestPeriodThread, uint32_t* minimumPeriod) {
-    *minimumPeriod = MAX_VAL;
+// Deadline Monotonic order: shorter relative deadline first. With implicit
+// deadlines (Di == Ti) this is the Rate Monotonic order. Equal deadlines are
+// tie-broken by the shorter period; threads with equal Di and Ti share a rank
+// and are time-sliced round-robin.
+static bool OS_rankedBefore(OSThread const *a, OSThread const *b) {
+    if (a->Di != b->Di) {
+        return a->Di < b->Di;
+    }
+    return a->Ti < b->Ti;
+}
+
+#if OS_SCHED_POLICY == OS_SCHED_RM
+// Append the thread to the ring of its rank, behind the one running (O(1))
+static void OS_rmInsert(OSThread *t) {
+    OSThread *head = OS_rmThread[t->rank];
+    if (head == (OSThread *)0) {
+        t->rrNext = t;
+        t->rrPrev = t;
+        OS_rmThread[t->rank] = t;
+        OS_rmReadySet |= (1U << (t->rank - 1U));
+    }
+    else {
+        t->rrNext = head;
+        t->rrPrev = head->rrPrev;
+        head->rrPrev->rrNext = t;
+        head->rrPrev = t;
+    }
+    t->sliceLeft = t->timeSlice;
+}
+
+// Unlink the thread from the ring of its rank (O(1))
+static void OS_rmRemove(OSThread *t) {
+    if (t->rrNext == t) {
+        OS_rmThread[t->rank] = (OSThread *)0;
+        OS_rmReadySet &= ~(1U << (t->rank - 1U));
+    }
+    else {
+        t->rrPrev->rrNext = t->rrNext;
+        t->rrNext->rrPrev = t->rrPrev;
+        if (OS_rmThread[t->rank] == t) {
+            OS_rmThread[t->rank] = t->rrNext;
+        }
+    }
+}
+#endif
+
+// Ranks at or above from move up by one (up), or ranks above from, which
+// must be free, move down by one: the threads, their RM ready rings and
+// OS_rmReadySet shift together, so nothing has to be rebuilt
+static void OS_rankShift(uint32_t from, bool up) {
+    uint32_t low = (1U << (from - 1U)) - 1U; /* bits of the ranks below from */
     for(uint32_t i = 1; i < ARRAY_SIZE(OS_thread); i++) {
-        if(OS_thread[i] && OS_thread[i]->Ti < *minimumPeriod) {
-            *minimumPeriod = OS_thread[i]->Ti;
-            *lowestPeriodThread = OS_thread[i];
+        OSThread *t = OS_thread[i];
+        if (t && up && (t->rank >= from)) {
+            ++t->rank;
+        }
+        else if (t && !up && (t->rank > from)) {
+            --t->rank;
         }
     }
+#if OS_SCHED_POLICY == OS_SCHED_RM
+    if (up) {
+        for(uint32_t r = ARRAY_SIZE(OS_rmThread) - 1U; r > from; r--) {
+            OS_rmThread[r] = OS_rmThread[r - 1U];
+        }
+        OS_rmThread[from] = (OSThread *)0;
+        OS_rmReadySet = (OS_rmReadySet & low) | ((OS_rmReadySet & ~low) << 1);
+    }
+    else {
+        for(uint32_t r = from; r < ARRAY_SIZE(OS_rmThread) - 1U; r++) {
+            OS_rmThread[r] = OS_rmThread[r + 1U];
+        }
+        OS_rmThread[ARRAY_SIZE(OS_rmThread) - 1U] = (OSThread *)0;
+        OS_rmReadySet = (OS_rmReadySet & low) | ((OS_rmReadySet >> 1) & ~low);
+    }
+#elif OS_SCHED_POLICY == OS_SCHED_EDF
+    /* the relative order of the ranks is kept, so the heap stays valid */
+    (void)low;
+    for(uint32_t i = 0; i < OS_edfCount; i++) {
+        OS_edfHeap[i].rank = OS_thread[OS_edfHeap[i].slot]->rank;
+    }
+#else
+    (void)low;
+#endif
 }
 
-void checkCompletedTask() {
-    for(uint32_t i = 1; i < ARRAY_SIZE(OS_thread); i++){
-    	if(OS_thread[i] && OSTotalTicks%OS_thread[i]->Ti == 0){
-    		OS_thread[i]->isActive = true;
-    		OS_thread[i]->remainingTime = OS_thread[i]->Ci;
-    	}
+// Does another thread share the rank of me, with equal Di and Ti?
+static bool OS_rankShared(OSThread const *me) {
+    for(uint32_t i = 1; i < ARRAY_SIZE(OS_thread); i++) {
+        OSThread const *t = OS_thread[i];
+        if (t && (t != me) && !OS_rankedBefore(t, me) && !OS_rankedBefore(me, t)) {
+            return true;
+        }
     }
+    return false;
 }
 
-void chooseNextThread(OSThread** next, uint32_t* nextPeriod) {
-    *nextPeriod = MAX_VAL;
+// Give a newly registered thread its RM/DM rank, the more urgent the higher
+// (1..32): one more than the number of threads it is more urgent than. The
+// threads more urgent than it move up by one; a shared rank does not.
+static void OS_rankInsert(OSThread *me) {
+    uint8_t rank = 1U;
     for(uint32_t i = 1; i < ARRAY_SIZE(OS_thread); i++) {
-        if(OS_thread[i] && OS_thread[i]->isActive && (OS_thread[i]->Ti < *nextPeriod && OS_thread[i]->Ti > OS_curr->Ti)) {
-            *nextPeriod = OS_thread[i]->Ti;
-            *next = OS_thread[i];
+        OSThread const *t = OS_thread[i];
+        if (t && (t != me) && OS_rankedBefore(me, t)) {
+            rank++;
+        }
+    }
+    me->rank = 0U; /* not shifted */
+    OS_rankShift(OS_rankShared(me) ? (rank + 1U) : rank, true);
+    me->rank = rank;
+}
+
+// Undo OS_rankInsert() for a thread unregistered before its first release
+static void OS_rankRemove(OSThread *me) {
+    OS_rankShift(OS_rankShared(me) ? (me->rank + 1U) : me->rank, false);
+}
+
+#if OS_SCHED_POLICY == OS_SCHED_EDF
+// EDF order: earlier absolute deadline first (modulo 2^32), ties by RM rank
+static bool OS_edfBefore(OSHeapEntry const *a, OSHeapEntry const *b) {
+    int32_t diff = (int32_t)(a->key - b->key);
+    return (diff < 0) || ((diff == 0) && (a->rank > b->rank));
+}
+
+static void OS_edfPlace(OSHeapEntry const *e, uint32_t i) {
+    OS_edfHeap[i] = *e;
+    OS_edfIndex[e->slot] = (uint8_t)i;
+}
+
+static void OS_edfSiftUp(uint32_t i) {
+    OSHeapEntry e = OS_edfHeap[i];
+    while (i > 0U && OS_edfBefore(&e, &OS_edfHeap[(i - 1U) / 2U])) {
+        OS_edfPlace(&OS_edfHeap[(i - 1U) / 2U], i);
+        i = (i - 1U) / 2U;
+    }
+    OS_edfPlace(&e, i);
+}
+
+static void OS_edfSiftDown(uint32_t i) {
+    OSHeapEntry e = OS_edfHeap[i];
+    for (;;) {
+        uint32_t child = 2U * i + 1U;
+        if (child >= OS_edfCount) {
+            break;
+        }
+        if (child + 1U < OS_edfCount
+            && OS_edfBefore(&OS_edfHeap[child + 1U], &OS_edfHeap[child])) {
+            child++;
+        }
+        if (!OS_edfBefore(&OS_edfHeap[child], &e)) {
+            break;
+        }
+        OS_edfPlace(&OS_edfHeap[child], i);
+        i = child;
+    }
+    OS_edfPlace(&e, i);
+}
+
+static void OS_edfRemove(OSThread *t) {
+    uint32_t i = OS_edfIndex[t->prio];
+    OSHeapEntry last = OS_edfHeap[--OS_edfCount];
+    if (last.slot != t->prio) {
+        OS_edfPlace(&last, i);
+        OS_edfSiftDown(i);
+        OS_edfSiftUp(OS_edfIndex[last.slot]);
+    }
+}
+#endif
+
+#if OS_SCHED_POLICY != OS_SCHED_EDF
+// Worst-case response time of t, interfered with by the threads ranked above
+// it and the ones sharing its rank, which round-robin with it:
+// R = Ci + B + sum(ceil(R / Tj) * Cj), iterated in integer ticks. The
+// iteration starts from the response time found at the previous admission,
+// which adding a thread can only increase, and stops past the deadline.
+static uint32_t OS_responseTime(OSThread const *t) {
+    uint32_t blocking = (t->rank > 1U) ? OS_ADMIT_BLOCKING : 0U;
+    uint32_t r = t->Ci + blocking;
+    uint32_t prev;
+    if (t->Ri > r) {
+        r = t->Ri;
+    }
+    do {
+        prev = r;
+        r = t->Ci + blocking;
+        for (uint32_t k = 1U; (k < ARRAY_SIZE(OS_thread)) && (r <= t->Di); k++) {
+            OSThread const *h = OS_thread[k];
+            if (h && (h != t) && (h->rank >= t->rank)) {
+                r += OS_interference(h, prev);
+            }
+        }
+    } while ((r != prev) && (r <= t->Di));
+    return r;
+}
+#endif
+
+uint32_t OS_interference(OSThread const *h, uint32_t window) {
+    if ((h == OS_server) && (OS_serverType == OS_SERVER_DEFERRABLE)) {
+        window += h->Ti - h->Ci; /* back-to-back: jitter Ts - Cs */
+    }
+    return ((window + h->Ti - 1U) / h->Ti) * h->Ci;
+}
+
+#if OS_SCHED_POLICY == OS_SCHED_EDF
+// Ratio c/d in Q16.16, rounded up so the test stays safe
+static uint32_t OS_q16Ratio(uint32_t c, uint32_t d) {
+    return (uint32_t)((((uint64_t)c << 16) + d - 1U) / d);
+}
+#endif
+
+// Admission control for a thread registered, but not yet released. The
+// incremental bound is checked first, in O(1): under EDF the total density
+// must not exceed 1, under RM/DM the hyperbolic product must not exceed 2.
+// Under RM/DM a set failing the bound gets the exact response-time test,
+// for the new thread and the ones ranked at or below it (and the ones right
+// above, which it may now block). As the kernel does not know the critical
+// section lengths, OS_ADMIT_BLOCKING ticks of NPP blocking are assumed: under
+// RM/DM charged to every thread; under EDF once per deadline level, as with
+// the SRP a job is blocked at most once, by a thread of longer relative
+// deadline: sum(Ci/Di, Di <= Dk) + B/Dk <= 1 for each such level k. The
+// density sum of each level is kept per thread, so the levels are checked
+// and updated in a single O(n) pass.
+// A dispatch table is generated from the RM/DM schedule, so the table mode
+// admits with the RM/DM test. The bound does not hold with a Deferrable
+// Server, which always gets the exact test.
+static bool OS_admit(OSThread *me) {
+#if OS_SCHED_POLICY == OS_SCHED_EDF
+    uint32_t load = OS_admitLoad + OS_q16Ratio(me->Ci, me->Di);
+    if (load > OS_Q16_ONE) {
+        return false;
+    }
+    uint32_t density = OS_q16Ratio(me->Ci, me->Di);
+    uint32_t mine = density; /* the density of the level of me */
+    uint32_t longest = me->Di; /* the levels below it may be blocked */
+    for (uint32_t k = 1U; k < ARRAY_SIZE(OS_thread); k++) {
+        OSThread const *t = OS_thread[k];
+        if (t && (t != me)) {
+            if (t->Di <= me->Di) {
+                mine += OS_q16Ratio(t->Ci, t->Di);
+            }
+            if (t->Di > longest) {
+                longest = t->Di;
+            }
+        }
+    }
+    for (uint32_t k = 1U; k < ARRAY_SIZE(OS_thread); k++) {
+        OSThread const *t = OS_thread[k];
+        uint32_t level;
+        if (t == (OSThread *)0) {
+            continue;
+        }
+        level = (t == me) ? mine
+                : (OS_admitLevel[k] + ((t->Di >= me->Di) ? density : 0U));
+        if ((t->Di < longest)
+            && (level + OS_q16Ratio(OS_ADMIT_BLOCKING, t->Di) > OS_Q16_ONE)) {
+            return false;
+        }
+    }
+    for (uint32_t k = 1U; k < ARRAY_SIZE(OS_thread); k++) {
+        OSThread const *t = OS_thread[k];
+        if (t && (t != me) && (t->Di >= me->Di)) {
+            OS_admitLevel[k] += density;
+        }
+    }
+    OS_admitLevel[me->prio] = mine;
+#else
+    uint32_t cost = me->Ci + OS_ADMIT_BLOCKING;
+    uint32_t load = (uint32_t)(((uint64_t)OS_admitLoad * (me->Di + cost)
+                                + me->Di - 1U) / me->Di);
+    if ((load > 2U * OS_Q16_ONE) || (OS_serverType == OS_SERVER_DEFERRABLE)) {
+        uint32_t above = ARRAY_SIZE(OS_rmThread); /* the next rank up */
+        for (uint32_t k = 1U; k < ARRAY_SIZE(OS_thread); k++) {
+            OSThread const *t = OS_thread[k];
+            if (t && (t->rank > me->rank) && (t->rank < above)) {
+                above = t->rank;
+            }
+        }
+        for (uint32_t k = 1U; k < ARRAY_SIZE(OS_thread); k++) {
+            OSThread const *t = OS_thread[k];
+            if (t && ((t->rank <= me->rank) || (t->rank == above))) {
+                OS_admitR[k] = OS_responseTime(t);
+                if (OS_admitR[k] > t->Di) {
+                    return false;
+                }
+            }
+        }
+        for (uint32_t k = 1U; k < ARRAY_SIZE(OS_thread); k++) {
+            OSThread *t = OS_thread[k];
+            if (t && ((t->rank <= me->rank) || (t->rank == above))) {
+                t->Ri = OS_admitR[k];
+            }
+        }
+    }
+#endif
+    OS_admitLoad = load;
+    return true;
+}
+
+#define JOB_SLOT(log_)  (&(log_)->ring[(log_)->count & (OS_JOB_LOG_SIZE - 1U)])
+Q_ASSERT_STATIC((OS_JOB_LOG_SIZE & (OS_JOB_LOG_SIZE - 1U)) == 0U);
+
+// Take the thread out of the background, where its overrunning job went
+static void OS_undemote(OSThread *t) {
+    if (t->demoted) {
+        OS_demotedSet &= ~(1U << (t->prio - 1U));
+        t->demoted = false;
+    }
+}
+
+// Take the active job of the thread out of the RM/EDF ready queue
+static void OS_jobUnready(OSThread *t) {
+#if OS_SCHED_POLICY == OS_SCHED_EDF
+    OS_edfRemove(t);
+#elif OS_SCHED_POLICY == OS_SCHED_RM
+    OS_rmRemove(t);
+#else
+    (void)t; /* the table decides, no ready queue */
+#endif
+}
+
+// Put the active job of the thread in the RM/EDF ready queue
+static void OS_jobReady(OSThread *t) {
+#if OS_SCHED_POLICY == OS_SCHED_EDF
+    Q_ASSERT(OS_edfCount < ARRAY_SIZE(OS_edfHeap));
+    OS_edfHeap[OS_edfCount].key = t->deadline;
+    OS_edfHeap[OS_edfCount].slot = t->prio;
+    OS_edfHeap[OS_edfCount].rank = t->rank;
+    OS_edfSiftUp(OS_edfCount++);
+#elif OS_SCHED_POLICY == OS_SCHED_RM
+    OS_rmInsert(t);
+#else
+    (void)t; /* the table decides, no ready queue */
+#endif
+}
+
+// A new job of the thread is released: give it a full budget
+void OS_jobRelease(OSThread *t) {
+    bool queued = t->isActive && !t->demoted;
+    if (t->isActive && ((t != OS_server) || (OS_serverType != OS_SERVER_DEFERRABLE))) {
+        ++t->deadlineMisses; /* the previous job is still not done: missed */
+    }
+    OS_undemote(t);
+    t->deadline = OSTotalTicks + t->Di;
+#if OS_SLACK_STEALING
+    ++OS_slackJob[t->prio];
+#endif
+    /* the record is filled in the slot past the last completed job */
+    JOB_SLOT(&t->jobLog)->release = OSTotalTicks;
+    JOB_SLOT(&t->jobLog)->deadline = t->deadline;
+    t->jobLog.started = false;
+#if OS_SCHED_POLICY == OS_SCHED_EDF
+    if (queued) { /* the previous job overran: it keeps its place */
+        OS_edfHeap[OS_edfIndex[t->prio]].key = t->deadline;
+        OS_edfSiftDown(OS_edfIndex[t->prio]);
+    }
+#endif
+    if (!queued) {
+        OS_jobReady(t);
+    }
+    t->isActive = true;
+    t->remainingTime = t->Ci;
+    t->budget = t->Ci;
+    t->execUs = 0U;
+    OS_schedEvents |= OS_EVT_RELEASE;
+
+    if ((t == OS_server) && (!aperiodicTaskPending() || OS_SERVER_BANDWIDTH())) {
+        /* nothing to serve: a Polling Server loses its capacity until the
+        * next period, a Deferrable Server waits with it for an arrival; a
+        * bandwidth server waits for OS_serverResume() to give it a deadline
+        */
+        OS_jobUnready(t);
+        t->isActive = false;
+    }
+}
+
+// The current job of the thread is done; it finishes at the current tick
+// (must be called with interrupts DISABLED)
+void OS_jobComplete(OSThread *t) {
+    if (t->isActive) {
+        OSJobLog *log = &t->jobLog;
+        OSJobRecord *rec = JOB_SLOT(log);
+        rec->finish = OSTotalTicks;
+        rec->response = rec->finish - rec->release;
+        rec->missed = (int32_t)(rec->finish - rec->deadline) > 0;
+        if (rec->missed) {
+            ++t->deadlineMisses; /* completed after its deadline */
+        }
+        if ((log->count == 0U) || (rec->response < log->minResponse)) {
+            log->minResponse = rec->response;
+        }
+        if (rec->response > log->maxResponse) {
+            log->maxResponse = rec->response;
+        }
+        log->sumResponse += rec->response;
+        ++log->count; /* publishes the record */
+    }
+    if (t->demoted) {
+        OS_undemote(t);
+    }
+    else if (t->isActive) {
+        OS_jobUnready(t);
+    }
+    t->isActive = false;
+    OS_schedEvents |= OS_EVT_COMPLETE;
+}
+
+// Budget enforcement: the thread is charged the time it actually ran. A job
+// that is still active once charged more than Ci ticks (plus the margin for
+// the tick jitter) overruns; the thread's hook is called and its overrun
+// action applied, so the other threads only ever see the Ci they were
+// admitted with. A job overrunning inside a critical section keeps the CPU
+// under the NPP until sem_post().
+void OS_budgetCharge(OSThread *t, uint32_t us) {
+#if OS_SLACK_STEALING
+    if ((t != OS_thread[0]) && !t->demoted) {
+        /* the work of its level and of the levels below, up to the switch
+        * after the job completes; kept cumulative so that OS_slackAvailable()
+        * needs no scratch array on the interrupted thread's stack
+        */
+        for (uint32_t r = 1U; r <= t->rank; r++) {
+            OS_slackWork[r] += us;
+        }
+    }
+#endif
+    if ((t == OS_thread[0]) || !t->isActive || t->demoted) {
+        return;
+    }
+    t->execUs += us;
+    if ((uint64_t)t->execUs <= (uint64_t)t->Ci * OS_TICK_US + OS_BUDGET_MARGIN_US) {
+        return;
+    }
+    ++t->overruns;
+    if (t->overrunHook != (OSOverrunHook)0) {
+        t->overrunHook(t);
+    }
+    OS_jobUnready(t);
+    OS_schedEvents |= OS_EVT_OVERRUN;
+    if (t->overrunAction == OS_OVERRUN_DEMOTE) {
+        t->demoted = true;
+        OS_demotedSet |= (1U << (t->prio - 1U));
+    }
+    else { /* suspended: the job cannot finish before its deadline */
+        ++t->deadlineMisses;
+        t->isActive = false;
+    }
+}
+
+// Has the active job of the periodic thread done all its work? TaskAction()
+// counts the work down in remainingTime; the job is still to complete.
+static bool OS_jobDone(OSThread const *t) {
+    return t->isActive && !t->demoted && (t->remainingTime == 0U)
+           && (t != OS_thread[0]) && (t != OS_server);
+}
+
+// Charge the running thread the time since it was last charged, at every
+// tick and every scheduling decision: a thread pays for the time it ran,
+// not for the whole tick in which the interrupt happens to find it. The
+// servers spend their capacity by ticks, in OS_serverCharge().
+static void OS_chargeCurr(void) {
+    uint64_t now = OS_clockUs();
+    if ((OS_curr != (OSThread *)0)
+        && ((OS_curr != OS_server) || !OS_curr->isActive)) {
+        OS_budgetCharge(OS_curr, (uint32_t)(now - OS_chargeStamp));
+    }
+    OS_chargeStamp = now;
+}
+
+// Give the capacity used by a Sporadic Server activation back at the given
+// tick. With the list full, the amount is added to the newest replenishment,
+// which is postponed to that tick: capacity may come back late, never early.
+static void OS_ssReplenishLater(uint32_t time, uint32_t amount) {
+    if (OS_ssReplCount == OS_SS_REPL_MAX) {
+        OSReplenishment *last = &OS_ssRepl[(OS_ssReplHead + OS_ssReplCount - 1U)
+                                           % OS_SS_REPL_MAX];
+        last->time = time;
+        last->amount += amount;
+    }
+    else {
+        OSReplenishment *r = &OS_ssRepl[(OS_ssReplHead + OS_ssReplCount)
+                                        % OS_SS_REPL_MAX];
+        r->time = time;
+        r->amount = amount;
+        ++OS_ssReplCount;
+    }
+}
+
+// Apply the Sporadic Server replenishments that are due
+static void OS_ssReplenish(OSThread *s) {
+    while ((OS_ssReplCount != 0U)
+           && (int32_t)(OSTotalTicks - OS_ssRepl[OS_ssReplHead].time) >= 0) {
+        s->budget += OS_ssRepl[OS_ssReplHead].amount;
+        OS_ssReplHead = (OS_ssReplHead + 1U) % OS_SS_REPL_MAX;
+        --OS_ssReplCount;
+    }
+}
+
+// The server ran during the tick that just ended, in which it executed one
+// unit of the earliest pending aperiodic job. Its job ends when the capacity
+// is used up or no aperiodic job is left, so it never overruns; whatever
+// capacity is left, only a Deferrable Server can use it in this period.
+// A Constant Bandwidth Server gets a full budget again at once, with its
+// deadline postponed by Ts, and goes on if aperiodic work is left. Returns
+// true when its job ends; OS_serverStop() then completes it at the new tick.
+static bool OS_serverCharge(OSThread *s) {
+    AperiodicTask *task = aperiodicTaskHead();
+    if (task != (AperiodicTask *)0) {
+        aperiodicTaskServe(task);
+    }
+    --s->budget;
+    ++OS_ssConsumed;
+    if ((s->budget == 0U) && (OS_serverType == OS_SERVER_CBS)) {
+        s->budget = s->Ci;
+        s->deadline += s->Ti;
+        JOB_SLOT(&s->jobLog)->deadline = s->deadline; /* the job goes on */
+#if OS_SCHED_POLICY == OS_SCHED_EDF
+        OS_edfHeap[OS_edfIndex[s->prio]].key = s->deadline;
+        OS_edfSiftDown(OS_edfIndex[s->prio]);
+#endif
+        OS_schedEvents |= OS_EVT_OVERRUN;
+    }
+    s->remainingTime = s->budget;
+    return (s->budget == 0U) || !aperiodicTaskPending();
+}
+
+// The server's job ends with the tick that just ended
+static void OS_serverStop(OSThread *s) {
+    OS_jobComplete(s);
+    if (OS_serverType == OS_SERVER_SPORADIC) {
+        OS_ssReplenishLater(OS_ssActivation + s->Ti, OS_ssConsumed);
+    }
+    OS_ssConsumed = 0U;
+}
+
+// An aperiodic job arrived while the Deferrable or Sporadic Server waits
+// with capacity left, or the Sporadic Server got capacity back while an
+// aperiodic job waits: it is ready at once, at its priority. Each such busy
+// interval is logged as a job of the server. A bandwidth server is ready
+// whenever an aperiodic job waits, with the deadline its rule gives.
+static void OS_serverResume(OSThread *s) {
+    if (OS_serverType == OS_SERVER_SPORADIC) { /* an activation begins */
+        OS_ssActivation = OSTotalTicks;
+        s->deadline = OSTotalTicks + s->Di;
+    }
+    else if (OS_serverType == OS_SERVER_TBS) {
+        /* TBS: the job runs at the bandwidth Cs/Ts from its arrival, or
+        * from the deadline of the previous job if that is later
+        */
+        AperiodicTask const *task = aperiodicTaskHead();
+        uint32_t from = ((int32_t)(task->arrivalTime - s->deadline) > 0)
+                        ? task->arrivalTime : s->deadline;
+        s->budget = task->remainingCost;
+        s->deadline = from + (uint32_t)(((uint64_t)task->remainingCost * s->Ti
+                                         + s->Ci - 1U) / s->Ci);
+    }
+    else if (OS_serverType == OS_SERVER_CBS) {
+        /* CBS: the budget and deadline left are kept only if using them
+        * from now on does not exceed the bandwidth Cs/Ts
+        */
+        uint32_t left = ((int32_t)(s->deadline - OSTotalTicks) > 0)
+                        ? (s->deadline - OSTotalTicks) : 0U;
+        if ((uint64_t)s->budget * s->Ti >= (uint64_t)left * s->Ci) {
+            s->budget = s->Ci;
+            s->deadline = OSTotalTicks + s->Ti;
+        }
+    }
+    /* the job is judged against the deadline in effect for it: the new
+    * one, or, for a Deferrable Server resumed within its period, that of
+    * the period
+    */
+    JOB_SLOT(&s->jobLog)->release = OSTotalTicks;
+    JOB_SLOT(&s->jobLog)->deadline = s->deadline;
+    s->jobLog.started = false;
+    s->isActive = true;
+    OS_jobReady(s);
+    OS_schedEvents |= OS_EVT_RELEASE;
+}
+
+// The server thread only holds the CPU at its priority; the aperiodic jobs
+// are executed by the kernel in the ticks charged to it
+static void OS_serverMain(void) {
+    while (1) {
+    }
+}
+
+// Release instants are compared modulo 2^32, so OSTotalTicks may wrap around
+#define RELEASE_BEFORE(a, b)  ((int32_t)((a).key - (b).key) < 0)
+
+static void OS_releaseSiftDown(uint32_t i) {
+    OSHeapEntry e = OS_releaseHeap[i];
+    for (;;) {
+        uint32_t child = 2U * i + 1U;
+        if (child >= OS_releaseCount) {
+            break;
+        }
+        if (child + 1U < OS_releaseCount
+            && RELEASE_BEFORE(OS_releaseHeap[child + 1U], OS_releaseHeap[child])) {
+            child++;
+        }
+        if (!RELEASE_BEFORE(OS_releaseHeap[child], e)) {
+            break;
+        }
+        OS_releaseHeap[i] = OS_releaseHeap[child];
+        i = child;
+    }
+    OS_releaseHeap[i] = e;
+}
+
+static void OS_releaseInsert(uint8_t slot, uint32_t release) {
+    uint32_t i = OS_releaseCount++;
+    OSHeapEntry e;
+    Q_ASSERT(i < ARRAY_SIZE(OS_releaseHeap));
+    e.key = release;
+    e.slot = slot;
+    e.rank = 0U;
+    while (i > 0U && RELEASE_BEFORE(e, OS_releaseHeap[(i - 1U) / 2U])) {
+        OS_releaseHeap[i] = OS_releaseHeap[(i - 1U) / 2U];
+        i = (i - 1U) / 2U;
+    }
+    OS_releaseHeap[i] = e;
+}
+
+// Release every thread whose next release instant has come. Only the top of
+// the release heap is examined, so a tick without releases costs one compare.
+void checkCompletedTask() {
+    while (OS_releaseCount != 0U
+           && (int32_t)(OSTotalTicks - OS_releaseHeap[0].key) >= 0) {
+        uint8_t slot = OS_releaseHeap[0].slot;
+        if ((OS_thread[slot] == OS_curr) && OS_jobDone(OS_curr)) {
+            /* its job did its work by this very tick: it completes first,
+            * on its way to OS_waitNextPeriod(), whose OS_sched() goes on
+            * with the releases
+            */
+            break;
         }
+        OS_jobRelease(OS_thread[slot]);
+        OS_releaseHeap[0].key += OS_period[slot];
+        OS_releaseSiftDown(0U);
     }
 }
 
+#if OS_SLACK_STEALING
+static uint32_t OS_gcd(uint32_t a, uint32_t b) {
+    while (b != 0U) {
+        uint32_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+// Fill the slack table of the thread: for each of its jobs in the
+// hyperperiod, the idle time in [0, D_ij] of the threads ranked at or
+// above it, released together at 0, less the NPP blocking it may suffer.
+// The idle time does not depend on the order in which they run, so only
+// their total backlog is followed, from release to release.
+static void OS_slackLevel(OSThread const *t, uint32_t *table) {
+    uint32_t blocking = (t->rank > 1U) ? OS_ADMIT_BLOCKING : 0U;
+    uint32_t now = 0U;
+    uint32_t backlog = 0U;
+    uint32_t idle = 0U;
+    for (uint32_t j = 0U; j < OS_slackHyperperiod / t->Ti; j++) {
+        uint32_t deadline = j * t->Ti + t->Di;
+        while (now < deadline) {
+            uint32_t next = deadline;
+            uint32_t run;
+            for (uint32_t k = 1U; k < ARRAY_SIZE(OS_thread); k++) {
+                OSThread const *h = OS_thread[k];
+                if (h && (h->rank >= t->rank)) {
+                    uint32_t release = (now / h->Ti + 1U) * h->Ti;
+                    if (now % h->Ti == 0U) {
+                        backlog += h->Ci;
+                    }
+                    if (release < next) {
+                        next = release;
+                    }
+                }
+            }
+            run = (backlog < next - now) ? backlog : (next - now);
+            backlog -= run;
+            idle += next - now - run;
+            now = next;
+        }
+        table[j] = (idle > blocking) ? (idle - blocking) : 0U;
+    }
+}
+
+// Build the slack tables of the threads started so far, over their
+// hyperperiod, which begins now
+static void OS_slackInit(void) {
+    uint64_t hyperperiod = 1U;
+    uint32_t n = 0U;
+
+    /* the slack goes to the aperiodic jobs directly, not to a server */
+    Q_REQUIRE(OS_server == (OSThread *)0);
+
+    for (uint32_t i = 1U; i < ARRAY_SIZE(OS_thread); i++) {
+        OSThread const *t = OS_thread[i];
+        if (t) {
+            hyperperiod = (hyperperiod / OS_gcd((uint32_t)hyperperiod, t->Ti)) * t->Ti;
+            Q_ASSERT(hyperperiod <= MAX_VAL);
+        }
+    }
+    /* the work is counted in us over a hyperperiod */
+    Q_ASSERT(hyperperiod <= MAX_VAL / OS_TICK_US);
+    OS_slackHyperperiod = (uint32_t)hyperperiod;
+    for (uint32_t i = 1U; i < ARRAY_SIZE(OS_thread); i++) {
+        OSThread const *t = OS_thread[i];
+        if (t) {
+            OS_slackFirst[i] = n;
+            n += OS_slackHyperperiod / t->Ti;
+            Q_ASSERT(n <= OS_SLACK_JOBS);
+            OS_slackLevel(t, &OS_slackTable[OS_slackFirst[i]]);
+        }
+    }
+    OS_slackFrame = OSTotalTicks;
+}
+
+// The slack of each thread is the table entry of its current job, or of
+// its next one once the current is done, less the ticks since the start
+// of the hyperperiod not spent on the work of its level (idle, aperiodic
+// or lower ranked); the CPU can be stolen for the smallest of them
+uint32_t OS_slackAvailable(void) {
+    uint32_t elapsed = OSTotalTicks - OS_slackFrame;
+    uint32_t slack = OS_slackHyperperiod - elapsed; /* to the end of the hyperperiod */
+
+    for (uint32_t i = 1U; i < ARRAY_SIZE(OS_thread); i++) {
+        OSThread const *t = OS_thread[i];
+        if (t) {
+            uint32_t j = OS_slackJob[i] - (t->isActive ? 1U : 0U);
+            if (j < OS_slackHyperperiod / t->Ti) { /* it has a job left in this hyperperiod */
+                uint32_t lost = elapsed - OS_slackWork[t->rank] / OS_TICK_US;
+                uint32_t s = OS_slackTable[OS_slackFirst[i] + j];
+                s = (s > lost) ? (s - lost) : 0U;
+                if (s < slack) {
+                    slack = s;
+                }
+            }
+        }
+    }
+    return slack;
+}
+#endif
+
 void OS_sched(void) {
     /* choose the next thread to execute... */
-    OSThread *next = OS_thread[0];
-    OSThread *lowestPeriodThread;
+    OSThread *next;
 
-    uint32_t minimumPeriod;
+    /* the running thread pays for the time up to the decision */
+    OS_chargeCurr();
 
-    checkLowestPriorityThread(&lowestPeriodThread, &minimumPeriod);
     checkCompletedTask();
 
-    uint32_t compareTicksPeriod = OSTotalTicks % lowestPeriodThread->Ti;
-
-    if(compareTicksPeriod == 0 || OSTotalTicks == 0 || lowestPeriodThread->isActive){
-    	next = lowestPeriodThread;
+    if (OS_nppOwner != (OSThread *)0) {
+        // NPP: the thread inside a critical section is never preempted
+        next = OS_nppOwner;
+    }
+    else if ((OS_curr != (OSThread *)0) && OS_jobDone(OS_curr)) {
+        // the running job did all its work with the tick that just ended:
+        // it is not preempted on its way to OS_waitNextPeriod(), so it
+        // completes at this very tick
+        next = OS_curr;
+    }
+#if OS_SLACK_STEALING
+    else if (aperiodicTaskPending() && (OS_slackAvailable() != 0U)) {
+        // slack stealing: the aperiodic jobs go ahead of the periodic ones,
+        // executed by the Background Server in the idle thread's ticks
+        next = OS_thread[0];
+    }
+#endif
+#if OS_SCHED_POLICY == OS_SCHED_EDF
+    else if (OS_edfCount != 0U) {
+        // EDF: the active job with the earliest absolute deadline
+        next = OS_thread[OS_edfHeap[0].slot];
+    }
+#elif OS_SCHED_POLICY == OS_SCHED_RM
+    else if (OS_rmReadySet != 0U) {
+        // RM: the highest rank with an active job, round-robin within it
+        next = OS_rmThread[LOG2(OS_rmReadySet)];
     }
-    else if(OS_curr->isActive){
-    	next = OS_curr;
+#else
+    else if (OS_DISPATCHED()->isActive && !OS_DISPATCHED()->demoted) {
+        // cyclic executive: the thread of the table entry in effect, as long
+        // as its job lasts; a job done early leaves its slot to the idle thread
+        next = OS_DISPATCHED();
     }
-    else if(!OS_curr->isActive){
-        uint32_t nextPeriod;
-        chooseNextThread(&next, &nextPeriod);
+#endif
+    else if (OS_demotedSet != 0U && !aperiodicTaskPending()) {
+        // background: an overrunning job demoted by the budget enforcement
+        next = OS_thread[LOG2(OS_demotedSet)];
+    }
+    else {
+        next = OS_thread[0];
+    }
+    /* the decision is up to date; an aperiodic job finished below is an
+    * event for the next tick
+    */
+    OS_schedEvents = 0U;
+
+    // The first dispatch of a job is its start time
+    if (next->isActive && !next->jobLog.started) {
+        JOB_SLOT(&next->jobLog)->start = OSTotalTicks;
+        next->jobLog.started = true;
     }
 
     // Check for idle periods and run aperiodic tasks
@@ -185,160 +1099,450 @@ void OS_sched(void) {
     /* trigger PendSV, if needed */
     if (next != OS_curr) {
         OS_next = next;
-        //*(uint32_t volatile *)0xE000ED04 = (1U << 28);
-        SCB->ICSR |= SCB_ICSR_PENDSVSET_Msk;
-        __asm volatile("dsb");
-//        __asm volatile("isb");
-    }
-    /*
-     * DSB - whenever a memory access needs to have completed before program execution progresses.
-     * ISB - whenever instruction fetches need to explicitly take place after a certain point in the program,
-     * for example after memory map updates or after writing code to be executed.
-     * (In practice, this means "throw away any prefetched instructions at this point".)
-     * */
-}
-
-// Get lowest period from array of tasks (lowest period means highest priority)
-uint32_t getLowestPeriod() {
-	uint32_t _lowestPeriod = OS_thread[1]->Ti;
-    for(uint32_t i = 1; i < ARRAY_SIZE(OS_thread); i++) {
-        if (OS_thread[i]->Ti < _lowestPeriod) {
-        	_lowestPeriod = OS_thread[i]->Ti;
-        }
+        OS_TRIGGER_PENDSV();
     }
-    return _lowestPeriod;
 }
 
 void OS_run() {
+#if OS_SCHED_POLICY == OS_SCHED_TABLE
+    /* the table must have been generated for this very thread set */
+    Q_ASSERT((OS_dispatchCount != 0U) && (OS_dispatchTable[0].time == 0U));
+    Q_ASSERT(OS_taskSetSignature() == OS_dispatchSignature);
+#endif
+
+#if OS_SLACK_STEALING
+    OS_slackInit();
+#endif
+
     /* callback to configure and start interrupts */
     OS_onStartup();
 
-    lowestPeriodTask = getLowestPeriod();
-
-    __disable_irq();
+    OS_INT_DISABLE();
     OS_sched();
-    __enable_irq();
+    OS_INT_ENABLE();
 
     /* the following code should never execute */
     Q_ERROR();
 }
 
 void OS_tick(void) {
-    uint32_t workingSet = OS_delayedSet;
-    while (workingSet != 0U) {
-        OSThread *t = OS_thread[LOG2(workingSet)];
-        uint32_t bit;
-        Q_ASSERT((t != (OSThread *)0) && (t->timeout != 0U));
+    bool serverDone = false;
+
+    /* the running thread pays for the time it ran in the tick that ended */
+    OS_chargeCurr();
+    if (OS_curr != (OSThread *)0) {
+        if ((OS_curr == OS_server) && OS_curr->isActive) {
+            serverDone = OS_serverCharge(OS_curr);
+        }
+#if OS_SCHED_POLICY == OS_SCHED_RM
+        /* round-robin: at the end of its slice the running thread goes
+        * behind the others of its rank
+        */
+        if (OS_curr->isActive && (OS_rmThread[OS_curr->rank] == OS_curr)
+            && (OS_curr->rrNext != OS_curr) && (--OS_curr->sliceLeft == 0U)) {
+            OS_curr->sliceLeft = OS_curr->timeSlice;
+            OS_rmThread[OS_curr->rank] = OS_curr->rrNext;
+            OS_schedEvents |= OS_EVT_SLICE;
+        }
+#endif
+    }
 
-        bit = (1U << (t->prio - 1U));
+    /* only the head of the delta list counts down, so the cost of a tick
+    * does not depend on the number of delayed threads
+    */
+    OSThread *t = OS_timeoutList;
+    if (t != (OSThread *)0) {
+        Q_ASSERT(t->timeout != 0U);
         --t->timeout;
-        if (t->timeout == 0U) {
+        while ((t != (OSThread *)0) && (t->timeout == 0U)) {
+            uint32_t bit = (1U << (t->prio - 1U));
             OS_readySet   |= bit;  /* insert to set */
             OS_delayedSet &= ~bit; /* remove from set */
+            t = t->timeoutNext;
+            OS_schedEvents |= OS_EVT_TIMEOUT;
         }
-        workingSet &= ~bit; /* remove from working set */
+        OS_timeoutList = t;
     }
 
     // Each OS_tick must increase our own TotalTicks variable
     OSTotalTicks++;
+    if (serverDone) {
+        OS_serverStop(OS_server);
+    }
+
+    /* the releases are done by OS_sched(), which must run if one is due */
+    if (OS_releaseCount != 0U
+        && (int32_t)(OSTotalTicks - OS_releaseHeap[0].key) >= 0) {
+        OS_schedEvents |= OS_EVT_RELEASE;
+    }
+    /* the Background Server runs one unit per tick from OS_sched(), and an
+    * aperiodic arrival takes the CPU back from a demoted job
+    */
+    if (((OS_curr == OS_thread[0]) || (OS_demotedSet != 0U))
+        && aperiodicTaskPending()) {
+        OS_schedEvents |= OS_EVT_APERIODIC;
+    }
+#if OS_SLACK_STEALING
+    if ((int32_t)(OSTotalTicks - OS_slackFrame - OS_slackHyperperiod) >= 0) {
+        /* a new hyperperiod: the tables start over */
+        OS_slackFrame += OS_slackHyperperiod;
+        for (uint32_t i = 0U; i < ARRAY_SIZE(OS_slackWork); i++) {
+            OS_slackWork[i] = 0U;
+            OS_slackJob[i] = 0U;
+        }
+    }
+    /* an aperiodic job may take the CPU from the running periodic thread */
+    if ((OS_curr != OS_thread[0]) && aperiodicTaskPending()
+        && (OS_slackAvailable() != 0U)) {
+        OS_schedEvents |= OS_EVT_APERIODIC;
+    }
+#endif
+    if (OS_serverType == OS_SERVER_SPORADIC) {
+        OS_ssReplenish(OS_server);
+    }
+    /* an aperiodic job waits: the Deferrable and Sporadic Servers resume if
+    * they have capacity left, the bandwidth servers always
+    */
+    if ((OS_server != (OSThread *)0) && (OS_serverType != OS_SERVER_POLLING)
+        && !OS_server->isActive
+        && ((OS_server->budget != 0U) || OS_SERVER_BANDWIDTH())
+        && aperiodicTaskPending()) {
+        OS_serverResume(OS_server);
+    }
+#if OS_SCHED_POLICY == OS_SCHED_TABLE
+    if ((int32_t)(OSTotalTicks - OS_dispatchNext) >= 0) {
+        OS_dispatchAdvance();
+        OS_schedEvents |= OS_EVT_DISPATCH;
+    }
+#endif
+}
+
+// Number of ticks until the next tick at which the kernel has work to do:
+// a job release, a timeout expiry, an aperiodic job for the Background
+// Server, a Sporadic Server replenishment or, in the table mode, the next
+// dispatch. An event raised since the last OS_sched(), such as an aperiodic
+// job finished in the idle thread while a periodic one waits on stolen
+// slack, needs the very next tick (must be called with interrupts DISABLED)
+uint32_t OS_nextEventTicks(void) {
+    uint32_t ticks = MAX_VAL;
+    if (OS_schedEvents != 0U) {
+        return 1U;
+    }
+    if (OS_releaseCount != 0U) {
+        ticks = OS_releaseHeap[0].key - OSTotalTicks;
+    }
+    if ((OS_timeoutList != (OSThread *)0) && (OS_timeoutList->timeout < ticks)) {
+        ticks = OS_timeoutList->timeout;
+    }
+    if ((OS_serverType == OS_SERVER_SPORADIC) && (OS_ssReplCount != 0U)
+        && (OS_ssRepl[OS_ssReplHead].time - OSTotalTicks < ticks)) {
+        ticks = OS_ssRepl[OS_ssReplHead].time - OSTotalTicks;
+    }
+#if OS_SCHED_POLICY == OS_SCHED_TABLE
+    if (OS_dispatchNext - OSTotalTicks < ticks) {
+        ticks = OS_dispatchNext - OSTotalTicks;
+    }
+#endif
+    if (aperiodicTaskCount != 0U) { /* the earliest arrival is the root */
+        uint32_t arrival = ((int32_t)(aperiodicTaskQueue[0].arrivalTime - OSTotalTicks) > 0)
+                           ? (aperiodicTaskQueue[0].arrivalTime - OSTotalTicks) : 1U;
+        if (arrival < ticks) {
+            ticks = arrival;
+        }
+    }
+    return (ticks != 0U) ? ticks : 1U;
+}
+
+// Account for ticks that elapsed while the SysTick was suppressed. The number
+// must be below OS_nextEventTicks(), so nothing expires or is released in them.
+void OS_tickAnnounce(uint32_t ticks) {
+    if (OS_timeoutList != (OSThread *)0) {
+        Q_ASSERT(OS_timeoutList->timeout > ticks);
+        OS_timeoutList->timeout -= ticks;
+    }
+    OSTotalTicks += ticks;
+}
+
+// Insert the thread in the delta list: each entry keeps its timeout
+// relative to the entry in front of it
+static void OS_timeoutInsert(OSThread *me, uint32_t ticks) {
+    OSThread **link = &OS_timeoutList;
+    while ((*link != (OSThread *)0) && ((*link)->timeout <= ticks)) {
+        ticks -= (*link)->timeout;
+        link = &(*link)->timeoutNext;
+    }
+    me->timeout = ticks;
+    me->timeoutNext = *link;
+    if (*link != (OSThread *)0) {
+        (*link)->timeout -= ticks;
+    }
+    *link = me;
 }
 
 void OS_delay(uint32_t ticks) {
     uint32_t bit;
-    __asm volatile ("cpsid i");
+    OS_INT_DISABLE();
 
     /* never call OS_delay from the idleThread */
     Q_REQUIRE(OS_curr != OS_thread[0]);
+    Q_REQUIRE(ticks != 0U);
 
-    OS_curr->timeout = ticks;
+    OS_timeoutInsert(OS_curr, ticks);
     bit = (1U << (OS_curr->prio - 1U));
     OS_readySet &= ~bit;
     OS_delayedSet |= bit;
     OS_sched();
-    __asm volatile ("cpsie i");
+    OS_INT_ENABLE();
 }
 
-void OSThread_start(
+bool OSThread_start(
     OSThread *me,
     uint8_t prio, /* thread priority */
     OSThreadHandler threadHandler,
     void *stkSto, uint32_t stkSize,
 	uint32_t Ci, uint32_t Ti)
 {
+    /* implicit deadline: each job is due by the next release */
+    return OSThread_startDeadline(me, prio, threadHandler, stkSto, stkSize, Ci, Ti, Ti);
+}
+
+bool OSThread_startDeadline(
+    OSThread *me,
+    uint8_t prio, /* thread priority */
+    OSThreadHandler threadHandler,
+    void *stkSto, uint32_t stkSize,
+	uint32_t Ci, uint32_t Ti, uint32_t Di)
+{
+    bool admitted = true;
 
     me->Ci = Ci;
     me->Ti = Ti;
+    me->Di = Di;
     me->startupTi = Ti;
     me->remainingTime = Ci;
-    me->isActive = true;
-
-
-    /* round down the stack top to the 8-byte boundary
-    * NOTE: ARM Cortex-M stack grows down from hi -> low memory
-    */
-    uint32_t *sp = (uint32_t *)((((uint32_t)stkSto + stkSize) / 8) * 8);
-    uint32_t *stk_limit;
+    me->isActive = false;
+    me->deadlineMisses = 0U;
+    me->Ri = 0U;
+    me->budget = Ci;
+    me->execUs = 0U;
+    me->overruns = 0U;
+    me->overrunAction = OS_OVERRUN_ACTION;
+    me->overrunHook = (OSOverrunHook)0;
+    me->demoted = false;
+    me->timeSlice = OS_TIME_SLICE;
+    me->sliceLeft = OS_TIME_SLICE;
+    me->rrNext = (OSThread *)0;
+    me->rrPrev = (OSThread *)0;
+
+    /* constrained deadline: 0 < Di <= Ti (the idle thread has neither) */
+    Q_REQUIRE((prio == 0U) || ((Di != 0U) && (Di <= Ti)));
 
     /* priority must be in ragne
     * and the priority level must be unused
     */
     Q_REQUIRE((prio < Q_DIM(OS_thread))
               && (OS_thread[prio] == (OSThread *)0));
+#if OS_SLACK_STEALING
+    /* the slack tables are built by OS_run() for the threads started before */
+    Q_REQUIRE(OS_slackHyperperiod == 0U);
+#endif
 
-    *(--sp) = (1U << 24);  /* xPSR */
-    *(--sp) = (uint32_t)threadHandler; /* PC */
-    *(--sp) = 0x0000000EU; /* LR  */
-    *(--sp) = 0x0000000CU; /* R12 */
-    *(--sp) = 0x00000003U; /* R3  */
-    *(--sp) = 0x00000002U; /* R2  */
-    *(--sp) = 0x00000001U; /* R1  */
-    *(--sp) = 0x00000000U; /* R0  */
-    /* additionally, fake registers R4-R11 */
-    *(--sp) = 0x0000000BU; /* R11 */
-    *(--sp) = 0x0000000AU; /* R10 */
-    *(--sp) = 0x00000009U; /* R9 */
-    *(--sp) = 0x00000008U; /* R8 */
-    *(--sp) = 0x00000007U; /* R7 */
-    *(--sp) = 0x00000006U; /* R6 */
-    *(--sp) = 0x00000005U; /* R5 */
-    *(--sp) = 0x00000004U; /* R4 */
-
-    /* save the top of the stack in the thread's attibute */
-    me->sp = sp;
-
-    /* round up the bottom of the stack to the 8-byte boundary */
-    stk_limit = (uint32_t *)(((((uint32_t)stkSto - 1U) / 8) + 1U) * 8);
-
-    /* pre-fill the unused part of the stack with 0xDEADBEEF */
-    for (sp = sp - 1U; sp >= stk_limit; --sp) {
-        *sp = 0xDEADBEEFU;
-    }
+    OS_INT_DISABLE();
 
     /* register the thread with the OS */
     OS_thread[prio] = me;
     me->prio = prio;
-    /* make the thread ready to run */
     if (prio > 0U) {
+        OS_rankInsert(me);
+        admitted = OS_admit(me);
+        if (!admitted) { /* unregister it again */
+            OS_thread[prio] = (OSThread *)0;
+            OS_rankRemove(me);
+        }
+    }
+    if (admitted) {
+        OS_portThreadInit(me, threadHandler, stkSto, stkSize);
+    }
+    /* make the thread ready to run */
+    if (admitted && (prio > 0U)) {
         OS_readySet |= (1U << (prio - 1U));
+
+        /* the first job is released right away */
+        OS_jobRelease(me);
+        OS_period[prio] = Ti;
+        if ((me != OS_server)
+            || ((OS_serverType != OS_SERVER_SPORADIC) && !OS_SERVER_BANDWIDTH())) {
+            /* the Sporadic Server gets capacity back by replenishments, and
+            * the bandwidth servers are resumed by the aperiodic arrivals
+            */
+            OS_releaseInsert(prio, OSTotalTicks + Ti);
+        }
+    }
+
+    OS_INT_ENABLE();
+    return admitted;
+}
+
+// FNV-1a over the parameters of the threads, in the order of their prio
+uint32_t OS_taskSetSignature(void) {
+    uint32_t hash = 2166136261U;
+    for (uint32_t i = 1U; i < ARRAY_SIZE(OS_thread); i++) {
+        OSThread const *t = OS_thread[i];
+        if (t) {
+            uint32_t const field[4] = { i, t->Ci, t->startupTi, t->Di };
+            for (uint32_t k = 0U; k < ARRAY_SIZE(field); k++) {
+                hash = (hash ^ field[k]) * 16777619U;
+            }
+        }
+    }
+    return hash;
+}
+
+static bool OS_serverStart(
+    OSThread *me,
+    uint8_t prio, /* thread priority */
+    void *stkSto, uint32_t stkSize,
+    uint32_t Cs, uint32_t Ts, uint8_t type)
+{
+    Q_REQUIRE((OS_server == (OSThread *)0) && (Cs != 0U));
+
+    /* set first: the first server job is released by OSThread_start() */
+    OS_server = me;
+    OS_serverType = type;
+    OS_ssActivation = OSTotalTicks;
+    if (!OSThread_start(me, prio, &OS_serverMain, stkSto, stkSize, Cs, Ts)) {
+        OS_server = (OSThread *)0;
+        OS_serverType = OS_SERVER_NONE;
+        return false;
+    }
+    if (type == OS_SERVER_TBS) {
+        me->deadline = OSTotalTicks; /* no previous job to wait for */
+    }
+    return true;
+}
+
+bool OS_pollingServerStart(
+    OSThread *me,
+    uint8_t prio, /* thread priority */
+    void *stkSto, uint32_t stkSize,
+    uint32_t Cs, uint32_t Ts)
+{
+    return OS_serverStart(me, prio, stkSto, stkSize, Cs, Ts, OS_SERVER_POLLING);
+}
+
+bool OS_deferrableServerStart(
+    OSThread *me,
+    uint8_t prio, /* thread priority */
+    void *stkSto, uint32_t stkSize,
+    uint32_t Cs, uint32_t Ts)
+{
+    /* its interference is only analysed for fixed priorities */
+    Q_REQUIRE(OS_SCHED_POLICY != OS_SCHED_EDF);
+    return OS_serverStart(me, prio, stkSto, stkSize, Cs, Ts, OS_SERVER_DEFERRABLE);
+}
+
+bool OS_sporadicServerStart(
+    OSThread *me,
+    uint8_t prio, /* thread priority */
+    void *stkSto, uint32_t stkSize,
+    uint32_t Cs, uint32_t Ts)
+{
+    /* the replenishment rule follows the fixed-priority analysis */
+    Q_REQUIRE(OS_SCHED_POLICY != OS_SCHED_EDF);
+    return OS_serverStart(me, prio, stkSto, stkSize, Cs, Ts, OS_SERVER_SPORADIC);
+}
+
+bool OS_tbsServerStart(
+    OSThread *me,
+    uint8_t prio, /* thread priority */
+    void *stkSto, uint32_t stkSize,
+    uint32_t Cs, uint32_t Ts)
+{
+    /* the deadlines it gives mean nothing to fixed priorities */
+    Q_REQUIRE(OS_SCHED_POLICY == OS_SCHED_EDF);
+    return OS_serverStart(me, prio, stkSto, stkSize, Cs, Ts, OS_SERVER_TBS);
+}
+
+bool OS_cbsServerStart(
+    OSThread *me,
+    uint8_t prio, /* thread priority */
+    void *stkSto, uint32_t stkSize,
+    uint32_t Cs, uint32_t Ts)
+{
+    Q_REQUIRE(OS_SCHED_POLICY == OS_SCHED_EDF);
+    return OS_serverStart(me, prio, stkSto, stkSize, Cs, Ts, OS_SERVER_CBS);
+}
+
+void OSThread_setTimeSlice(OSThread *me, uint32_t ticks) {
+    Q_REQUIRE(ticks != 0U);
+    OS_INT_DISABLE();
+    me->timeSlice = ticks;
+    if (me->sliceLeft > ticks) {
+        me->sliceLeft = ticks;
     }
+    OS_INT_ENABLE();
+}
+
+void OSThread_setOverrun(OSThread *me, uint8_t action, OSOverrunHook hook) {
+    Q_REQUIRE((action == OS_OVERRUN_SUSPEND) || (action == OS_OVERRUN_DEMOTE));
+    OS_INT_DISABLE();
+    me->overrunAction = action;
+    me->overrunHook = hook;
+    OS_INT_ENABLE();
+}
+
+bool OS_jobRecordGet(OSThread const *t, uint32_t age, OSJobRecord *rec) {
+    bool found;
+    OS_INT_DISABLE();
+    found = (age < t->jobLog.count) && (age < OS_JOB_LOG_SIZE);
+    if (found) {
+        *rec = t->jobLog.ring[(t->jobLog.count - 1U - age) & (OS_JOB_LOG_SIZE - 1U)];
+    }
+    OS_INT_ENABLE();
+    return found;
+}
+
+uint32_t OS_jobMeanResponse(OSThread const *t) {
+    uint64_t sum;
+    uint32_t count;
+    OS_INT_DISABLE();
+    sum = t->jobLog.sumResponse;
+    count = t->jobLog.count;
+    OS_INT_ENABLE();
+    return (count != 0U) ? (uint32_t)(sum / count) : 0U;
 }
 
 void TaskAction(OSThread *task, uint32_t remainingTime, uint32_t *counterVisualizer){
 	uint32_t ticksPassed = OSTotalTicks;
 	while(remainingTime > 0){
 		task->remainingTime--;
-		if(task->remainingTime == 0){
-			task->isActive = false;
-		}
+		remainingTime--;
+		*counterVisualizer += 1;
+		// Each unit lasts up to the next tick, the last one included:
+		// OS_waitNextPeriod() then finishes the job at that tick
 		while(ticksPassed == OSTotalTicks) {
             // Do nothing
         }
 		ticksPassed = OSTotalTicks;
-		remainingTime--;
-		*counterVisualizer += 1;
 	}
 }
 
+// Finish the current job of the calling thread and block it until its next
+// release. The thread leaves the ready queue at once, so the CPU goes to
+// lower-priority work, or to the idle thread, without waiting for the tick.
+void OS_waitNextPeriod(void) {
+    OS_INT_DISABLE();
+
+    /* never from the idleThread, nor inside a critical section */
+    Q_REQUIRE((OS_curr != OS_thread[0]) && (OS_curr != OS_nppOwner));
+
+    if (OS_curr->isActive) {
+        OS_jobComplete(OS_curr);
+    }
+    OS_sched();
+    OS_INT_ENABLE();
+}
+
 void sem_init(semaphore* s, int32_t initValue) {
 	Q_ASSERT(s);
 	s->semCount = initValue;
@@ -348,7 +1552,7 @@ void sem_init(semaphore* s, int32_t initValue) {
 void sem_wait(semaphore* s, OSThread* taskCaller) {
 	Q_ASSERT(s);
 	Q_ASSERT(taskCaller);
-	__disable_irq();
+	OS_INT_DISABLE();
 	if (s->semCount == 0) {
 		s->isBlocked = true;
 	}
@@ -359,66 +1563,26 @@ void sem_wait(semaphore* s, OSThread* taskCaller) {
 		}
 	}
 	s->semCount--;
-	OS_sched();
 
 	// The task now has the highest priority
-	taskCaller->Ti = lowestPeriodTask - 1;
+	OS_nppOwner = taskCaller;
+	OS_schedEvents |= OS_EVT_SEM;
+	OS_sched();
 }
 
 void sem_post(semaphore* s, OSThread* taskCaller) {
 	Q_ASSERT(s);
-	__disable_irq();
+	OS_INT_DISABLE();
 	s->semCount++;
 	if (s->isBlocked == true) {
 		s->isBlocked = false;
 	}
-	__enable_irq();
-	OS_sched();
-
-	// Give back the original priority (and period) to the task
-	taskCaller->Ti = taskCaller->startupTi;
-}
-
-__attribute__ ((naked, optimize("-fno-stack-protector")))
-void PendSV_Handler(void) {
-__asm volatile (
 
-    /* __disable_irq(); */
-    "  CPSID         I                 \n"
-
-    /* if (OS_curr != (OSThread *)0) { */
-    "  LDR           r1,=OS_curr       \n"
-    "  LDR           r1,[r1,#0x00]     \n"
-    "  CBZ           r1,PendSV_restore \n"
-
-    /*     push registers r4-r11 on the stack */
-    "  PUSH          {r4-r11}          \n"
-
-    /*     OS_curr->sp = sp; */
-    "  LDR           r1,=OS_curr       \n"
-    "  LDR           r1,[r1,#0x00]     \n"
-    "  STR           sp,[r1,#0x00]     \n"
-    /* } */
-
-    "PendSV_restore:                   \n"
-    /* sp = OS_next->sp; */
-    "  LDR           r1,=OS_next       \n"
-    "  LDR           r1,[r1,#0x00]     \n"
-    "  LDR           sp,[r1,#0x00]     \n"
-
-    /* OS_curr = OS_next; */
-    "  LDR           r1,=OS_next       \n"
-    "  LDR           r1,[r1,#0x00]     \n"
-    "  LDR           r2,=OS_curr       \n"
-    "  STR           r1,[r2,#0x00]     \n"
-
-    /* pop registers r4-r11 */
-    "  POP           {r4-r11}          \n"
-
-    /* __enable_irq(); */
-    "  CPSIE         I                 \n"
-
-    /* return to the next thread */
-    "  BX            lr                \n"
-    );
+	// Give back the original priority to the task
+	if (OS_nppOwner == taskCaller) {
+		OS_nppOwner = (OSThread *)0;
+	}
+	OS_schedEvents |= OS_EVT_SEM;
+	OS_sched();
+	OS_INT_ENABLE();
 }
@@ -0,0 +1,97 @@
+/****************************************************************************
+* MInimal Real-time Operating System (MiROS), STM32F1 microsecond clock.
+*
+* A free-running 64-bit microsecond clock built from two chained 16-bit
+* timers, independent of the SysTick rate:
+* - TIM2 counts microseconds (prescaled to 1 MHz) and, as master, outputs
+*   its update event on TRGO,
+* - TIM3, as slave in external clock mode 1 on ITR1 (= TIM2 TRGO), counts
+*   the TIM2 overflows,
+* - the upper 32 bits are kept in software and incremented by the TIM3
+*   update interrupt, i.e. once every 2^32 us (~71.6 minutes).
+*
+* SPDX-License-Identifier: GPL-3.0-or-later
+****************************************************************************/
+#include <stdint.h>
+#include "stm32f1xx_hal.h"
+#include "miros.h"
+
+static TIM_HandleTypeDef l_tim2; /* low 16 bits [us] */
+static TIM_HandleTypeDef l_tim3; /* middle 16 bits [2^16 us] */
+static uint32_t volatile l_clockHi; /* upper 32 bits [2^32 us] */
+
+void OS_clockInit(void) {
+    TIM_ClockConfigTypeDef clk = {0};
+    TIM_MasterConfigTypeDef master = {0};
+    TIM_SlaveConfigTypeDef slave = {0};
+    uint32_t timClk = HAL_RCC_GetPCLK1Freq();
+
+    /* the APB1 timers run at twice PCLK1 when APB1 is prescaled */
+    if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1) {
+        timClk *= 2U;
+    }
+
+    l_tim2.Instance = TIM2;
+    l_tim2.Init.Prescaler = (timClk / 1000000U) - 1U;
+    l_tim2.Init.CounterMode = TIM_COUNTERMODE_UP;
+    l_tim2.Init.Period = 0xFFFFU;
+    l_tim2.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    l_tim2.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+    HAL_TIM_Base_Init(&l_tim2);
+    clk.ClockSource = TIM_CLOCKSOURCE_INTERNAL;
+    HAL_TIM_ConfigClockSource(&l_tim2, &clk);
+    master.MasterOutputTrigger = TIM_TRGO_UPDATE;
+    master.MasterSlaveMode = TIM_MASTERSLAVEMODE_ENABLE;
+    HAL_TIMEx_MasterConfigSynchronization(&l_tim2, &master);
+
+    l_tim3.Instance = TIM3;
+    l_tim3.Init.Prescaler = 0U;
+    l_tim3.Init.CounterMode = TIM_COUNTERMODE_UP;
+    l_tim3.Init.Period = 0xFFFFU;
+    l_tim3.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    l_tim3.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+    HAL_TIM_Base_Init(&l_tim3);
+    slave.SlaveMode = TIM_SLAVEMODE_EXTERNAL1;
+    slave.InputTrigger = TIM_TS_ITR1;
+    HAL_TIM_SlaveConfigSynchro(&l_tim3, &slave);
+
+    /* HAL_TIM_Base_Init() leaves the update flags set */
+    __HAL_TIM_CLEAR_FLAG(&l_tim2, TIM_FLAG_UPDATE);
+    __HAL_TIM_CLEAR_FLAG(&l_tim3, TIM_FLAG_UPDATE);
+    l_clockHi = 0U;
+
+    HAL_TIM_Base_Start_IT(&l_tim3); /* the slave first, then the master */
+    HAL_TIM_Base_Start(&l_tim2);
+}
+
+/* called from TIM3_IRQHandler() on every overflow of the 32-bit hardware part */
+void OS_clockIsr(void) {
+    if ((TIM3->SR & TIM_SR_UIF) != 0U) {
+        TIM3->SR = ~TIM_SR_UIF; /* clear before counting, see OS_clockUs() */
+        ++l_clockHi;
+    }
+}
+
+/* Lock-free read, callable from threads and ISRs alike: the snapshot is
+* retried if TIM3 or the upper word changed while it was taken. An overflow
+* whose interrupt has not run yet (e.g. read with interrupts disabled) is
+* recognized by the pending TIM3 update flag.
+*/
+uint64_t OS_clockUs(void) {
+    uint32_t hi;
+    uint32_t mid;
+    uint32_t lo;
+    uint32_t pending;
+
+    do {
+        hi = l_clockHi;
+        mid = TIM3->CNT;
+        lo = TIM2->CNT;
+        pending = TIM3->SR & TIM_SR_UIF;
+    } while ((mid != TIM3->CNT) || (hi != l_clockHi));
+
+    if ((pending != 0U) && (mid < 0x8000U)) {
+        ++hi;
+    }
+    return ((uint64_t)hi << 32) | (mid << 16) | lo;
+}
@@ -0,0 +1,39 @@
+/* Dispatch table of the OS_SCHED_TABLE (cyclic executive) mode:
+* from each time on, in ticks into the hyperperiod, the thread of
+* that prio runs (0 is the idle thread).
+*
+* Generated by the simulator (make -C Host table) from one
+* hyperperiod of the application, DO NOT EDIT.
+*/
+#include <stdint.h>
+#include "miros.h"
+
+#if OS_SCHED_POLICY == OS_SCHED_TABLE
+OSDispatchEntry const OS_dispatchTable[] = {
+    {       0U,  5U },
+    {     300U,  2U },
+    {     400U,  1U },
+    {     500U,  5U },
+    {     800U,  2U },
+    {     900U,  0U },
+    {    1000U,  5U },
+    {    1300U,  1U },
+    {    1400U,  0U },
+    {    1500U,  5U },
+    {    1800U,  2U },
+    {    1900U,  0U },
+    {    2000U,  5U },
+    {    2300U,  1U },
+    {    2400U,  2U },
+    {    2500U,  5U },
+    {    2800U,  0U },
+    {    3000U,  5U },
+    {    3300U,  2U },
+    {    3400U,  1U },
+    {    3500U,  5U },
+    {    3800U,  0U },
+};
+uint32_t const OS_dispatchCount = 22U;
+uint32_t const OS_dispatchHyperperiod = 4000U;
+uint32_t const OS_dispatchSignature = 0x97CF2557U;
+#endif
@@ -31,7 +31,12 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
-
+/* measure the cycles of the SysTick (OS_tick() + OS_sched()) and of each
+ * OS_sched() call in it with the DWT cycle counter; the results can be
+ * watched live with the debugger */
+#ifndef OS_SCHED_PROFILE
+#define OS_SCHED_PROFILE 0
+#endif
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -41,7 +46,16 @@
 
 /* Private variables ---------------------------------------------------------*/
 /* USER CODE BEGIN PV */
-
+#if OS_SCHED_PROFILE
+uint32_t volatile OS_tickCycles;     /* last SysTick */
+uint32_t volatile OS_tickCyclesMax;  /* worst SysTick */
+uint64_t volatile OS_tickCyclesSum;  /* average = OS_tickCyclesSum / OS_tickCount */
+uint32_t volatile OS_tickCount;
+uint32_t volatile OS_schedCycles;    /* last OS_sched() call */
+uint32_t volatile OS_schedCyclesMax; /* worst OS_sched() call */
+uint64_t volatile OS_schedCyclesSum; /* average = OS_schedCyclesSum / OS_schedCount */
+uint32_t volatile OS_schedCount;
+#endif
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -187,23 +201,120 @@ void SysTick_Handler(void)
   /* USER CODE END SysTick_IRQn 0 */
   HAL_IncTick();
   /* USER CODE BEGIN SysTick_IRQn 1 */
+#if OS_SCHED_PROFILE
+  uint32_t start = DWT->CYCCNT;
+#endif
   OS_tick();
-  __disable_irq();
-  OS_sched();
-  __enable_irq();
+  if (OS_schedEvents != 0U) { /* else the scheduling decision still holds */
+      __disable_irq();
+#if OS_SCHED_PROFILE
+      uint32_t schedStart = DWT->CYCCNT;
+      OS_sched();
+      OS_schedCycles = DWT->CYCCNT - schedStart;
+      if (OS_schedCycles > OS_schedCyclesMax) {
+          OS_schedCyclesMax = OS_schedCycles;
+      }
+      OS_schedCyclesSum += OS_schedCycles;
+      ++OS_schedCount;
+#else
+      OS_sched();
+#endif
+      __enable_irq();
+  }
+#if OS_SCHED_PROFILE
+  OS_tickCycles = DWT->CYCCNT - start;
+  if (OS_tickCycles > OS_tickCyclesMax) {
+      OS_tickCyclesMax = OS_tickCycles;
+  }
+  OS_tickCyclesSum += OS_tickCycles;
+  ++OS_tickCount;
+#endif
   /* USER CODE END SysTick_IRQn 1 */
 }
 
 void OS_onStartup(void) {
     SystemCoreClockUpdate();
+    OS_clockInit();
+#if OS_SCHED_PROFILE
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0U;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
     SysTick_Config(SystemCoreClock / TICKS_PER_SEC);
 
     /* set the SysTick interrupt priority (highest) */
     NVIC_SetPriority(SysTick_IRQn, 0U);
 }
 
+#if OS_TICKLESS
+/* Tickless idle: stretch the SysTick period up to the next scheduler event,
+ * sleep, and on wake-up account the whole ticks that passed in between.
+ * The SysTick is a 24-bit down-counter, so one stretch is limited to
+ * SysTick_LOAD_RELOAD_Msk cycles.
+ */
+static void OS_tickless(void) {
+    uint32_t reload = SysTick->LOAD + 1U; /* cycles per tick */
+    uint32_t ticks = OS_nextEventTicks();
+    uint32_t sleepLoad;
+    uint32_t valBefore;
+    uint32_t valAfter;
+    uint32_t done;      /* whole ticks elapsed, not counting a pending one */
+    uint32_t fraction;  /* cycles left until the next tick boundary */
+
+    if (ticks > (SysTick_LOAD_RELOAD_Msk / reload)) {
+        ticks = SysTick_LOAD_RELOAD_Msk / reload;
+    }
+    if ((ticks <= 1U) || ((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0U)) {
+        return; /* the next tick is needed anyway */
+    }
+
+    /* the current tick still ends on time, the next (ticks - 1) are skipped */
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    valBefore = SysTick->VAL;
+    sleepLoad = valBefore + ((ticks - 1U) * reload);
+    SysTick->LOAD = sleepLoad - 1U;
+    SysTick->VAL = 0U;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+    __DSB();
+    __WFI(); /* stop the CPU and Wait for Interrupt */
+    __ISB();
+
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    valAfter = SysTick->VAL;
+    if ((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0U) {
+        /* woken by the SysTick: its handler processes the last tick */
+        uint32_t late = sleepLoad - valAfter;
+        done = ticks - 1U;
+        fraction = (late < reload) ? (reload - late) : 1U;
+    }
+    else {
+        /* woken early by another interrupt */
+        uint32_t elapsed = (reload - valBefore) + (sleepLoad - valAfter);
+        done = elapsed / reload;
+        fraction = reload - (elapsed % reload);
+    }
+
+    /* finish the current tick, then resume the normal period */
+    if (fraction < 2U) {
+        fraction = 2U; /* LOAD == 0 would stop the counter */
+    }
+    SysTick->LOAD = fraction - 1U;
+    SysTick->VAL = 0U;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    SysTick->LOAD = reload - 1U;
+
+    OS_tickAnnounce(done);
+    uwTick += done * uwTickFreq;
+}
+#endif
+
 void OS_onIdle(void) {
-#ifdef NDBEBUG
+#if OS_TICKLESS
+    __disable_irq();
+    OS_tickless();
+    __enable_irq();
+#elif defined(NDBEBUG)
     __WFI(); /* stop the CPU and Wait for Interrupt */
 #endif
 }
@@ -222,6 +333,16 @@ void Q_onAssert(char const *module, int loc) {
 /* please refer to the startup file (startup_stm32f1xx.s).                    */
 /******************************************************************************/
 
+/**
+  * @brief This function handles TIM3 global interrupt.
+  */
+void TIM3_IRQHandler(void)
+{
+  /* USER CODE BEGIN TIM3_IRQn 0 */
+  OS_clockIsr();
+  /* USER CODE END TIM3_IRQn 0 */
+}
+
 /* USER CODE BEGIN 1 */
 
 /* USER CODE END 1 */